@@ -0,0 +1,296 @@
+#include "Endpoint.h"
+
+#include <cctype>
+#include <cstring>
+
+namespace
+{
+    const struct
+    {
+        int status;
+        const char *reason;
+    } REASONS[] = {
+        {200, "OK"},
+        {400, "Bad Request"},
+        {404, "Not Found"},
+        {405, "Method Not Allowed"},
+        {406, "Not Acceptable"},
+        {431, "Request Header Fields Too Large"},
+        {500, "Internal Server Error"},
+        {501, "Not Implemented"},
+        {503, "Service Unavailable"},
+    };
+
+    void Trim(const char *&begin, const char *&end)
+    {
+        while (begin < end && (*begin == ' ' || *begin == '\t'))
+        {
+            ++begin;
+        }
+        while (end > begin && (end[-1] == ' ' || end[-1] == '\t'))
+        {
+            --end;
+        }
+    }
+
+    bool Equals(const char *text, std::size_t length, const char *word, std::size_t wordLength)
+    {
+        if (length != wordLength)
+        {
+            return false;
+        }
+        for (std::size_t i = 0; i < length; ++i)
+        {
+            if (std::tolower(static_cast<unsigned char>(text[i])) != std::tolower(static_cast<unsigned char>(word[i])))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // A q-value in thousandths: "1", "0.5", "0.125". Malformed ones count
+    // as 1, as if there were none.
+    int Quality(const char *begin, const char *end)
+    {
+        int quality = 0;
+        int scale = 1000;
+        bool fraction = false;
+        for (const char *p = begin; p < end; ++p)
+        {
+            if (*p == '.' && !fraction)
+            {
+                fraction = true;
+            }
+            else if (*p >= '0' && *p <= '9' && (fraction ? scale > 1 : p == begin))
+            {
+                if (fraction)
+                {
+                    scale /= 10;
+                }
+                quality += (*p - '0') * scale;
+            }
+            else
+            {
+                return 1000;
+            }
+        }
+        return begin == end || quality > 1000 ? 1000 : quality;
+    }
+
+    // How much the Accept header wants `type`, from 0 to 1000. The most
+    // specific matching range decides: "text/html" over "text/*" over "*/*".
+    int Acceptance(const char *accept, std::size_t length, const char *type)
+    {
+        const std::size_t typeLength = std::strlen(type);
+        const char *const slash = static_cast<const char *>(std::memchr(type, '/', typeLength));
+        const std::size_t majorLength = slash ? slash - type + 1 : typeLength;
+
+        int best = 0;
+        int bestSpecificity = 0;
+        const char *const end = accept + length;
+        for (const char *item = accept; item < end;)
+        {
+            const char *itemEnd = static_cast<const char *>(std::memchr(item, ',', end - item));
+            if (!itemEnd)
+            {
+                itemEnd = end;
+            }
+            const char *rangeEnd = static_cast<const char *>(std::memchr(item, ';', itemEnd - item));
+            if (!rangeEnd)
+            {
+                rangeEnd = itemEnd;
+            }
+            const char *range = item;
+            const char *trimmedEnd = rangeEnd;
+            Trim(range, trimmedEnd);
+            const std::size_t rangeLength = trimmedEnd - range;
+
+            int specificity = 0;
+            if (Equals(range, rangeLength, type, typeLength))
+            {
+                specificity = 3;
+            }
+            else if (rangeLength == majorLength + 1 && range[rangeLength - 1] == '*' && Equals(range, majorLength, type, majorLength))
+            {
+                specificity = 2;
+            }
+            else if (Equals(range, rangeLength, "*/*", 3))
+            {
+                specificity = 1;
+            }
+
+            if (specificity > bestSpecificity)
+            {
+                int quality = 1000;
+                for (const char *parameter = rangeEnd; parameter < itemEnd;)
+                {
+                    const char *parameterEnd = static_cast<const char *>(std::memchr(parameter + 1, ';', itemEnd - parameter - 1));
+                    if (!parameterEnd)
+                    {
+                        parameterEnd = itemEnd;
+                    }
+                    const char *name = parameter + 1;
+                    const char *nameEnd = parameterEnd;
+                    Trim(name, nameEnd);
+                    if (nameEnd - name >= 2 && (name[0] == 'q' || name[0] == 'Q') && name[1] == '=')
+                    {
+                        quality = Quality(name + 2, nameEnd);
+                    }
+                    parameter = parameterEnd;
+                }
+                best = quality;
+                bestSpecificity = specificity;
+            }
+            item = itemEnd + 1;
+        }
+        return best;
+    }
+}
+
+Reply::Reply()
+{
+    reset();
+}
+
+void Reply::reset()
+{
+    status_ = 200;
+    contentType_ = "text/plain";
+    allow_ = nullptr;
+    vary_ = nullptr;
+    buffer_.clear();
+    pieces_.clear();
+    contentLength_ = 0;
+}
+
+void Reply::setStatus(int status)
+{
+    status_ = status;
+}
+
+const char *Reply::reason() const
+{
+    for (const auto &entry : REASONS)
+    {
+        if (entry.status == status_)
+        {
+            return entry.reason;
+        }
+    }
+    return "Unknown";
+}
+
+void Reply::add(const char *data, std::size_t length)
+{
+    Piece piece = {data, 0, length};
+    pieces_.push_back(piece);
+    contentLength_ += length;
+}
+
+void Reply::append(const char *data, std::size_t length)
+{
+    // Runs of appends share one piece.
+    if (pieces_.empty() || pieces_.back().data || pieces_.back().offset + pieces_.back().length != buffer_.size())
+    {
+        Piece piece = {nullptr, buffer_.size(), 0};
+        pieces_.push_back(piece);
+    }
+    buffer_.append(data, length);
+    pieces_.back().length += length;
+    contentLength_ += length;
+}
+
+void Reply::appendNumber(std::size_t value)
+{
+    char digits[24];
+    char *end = digits + sizeof(digits);
+    char *begin = end;
+    do
+    {
+        *--begin = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value);
+    append(begin, end - begin);
+}
+
+void Reply::error(int status, const char *allow)
+{
+    reset();
+    setStatus(status);
+    setAllow(allow);
+    appendNumber(static_cast<std::size_t>(status));
+    append(" ");
+    append(reason());
+    append("\n");
+}
+
+const char *Reply::data(std::size_t piece) const
+{
+    const Piece &p = pieces_[piece];
+    return p.data ? p.data : buffer_.data() + p.offset;
+}
+
+bool Endpoint::Request::query(const char *name, const char *&value, std::size_t &length) const
+{
+    const std::size_t nameLength = std::strlen(name);
+    const char *end = match.query + match.queryLength;
+    for (const char *pair = match.query; pair && pair < end;)
+    {
+        const char *pairEnd = static_cast<const char *>(std::memchr(pair, '&', end - pair));
+        if (!pairEnd)
+        {
+            pairEnd = end;
+        }
+        if (static_cast<std::size_t>(pairEnd - pair) >= nameLength && std::memcmp(pair, name, nameLength) == 0)
+        {
+            const char *rest = pair + nameLength;
+            if (rest == pairEnd || *rest == '=')
+            {
+                value = rest == pairEnd ? rest : rest + 1;
+                length = pairEnd - value;
+                return true;
+            }
+        }
+        pair = pairEnd + 1;
+    }
+    return false;
+}
+
+int Endpoint::Request::negotiate(const char *const types[], int count) const
+{
+    if (!accept || acceptLength == 0)
+    {
+        return count > 0 ? 0 : -1;
+    }
+
+    int chosen = -1;
+    int best = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        const int quality = Acceptance(accept, acceptLength, types[i]);
+        if (quality > best)
+        {
+            chosen = i;
+            best = quality;
+        }
+    }
+    return chosen;
+}
+
+void Endpoint::dispatch(const Request &request, Reply &reply)
+{
+    reply.reset();
+    switch (request.match.result)
+    {
+    case Router::Match::FOUND:
+        request.match.endpoint->handle(request, reply);
+        break;
+    case Router::Match::METHOD_NOT_ALLOWED:
+        reply.error(405, request.match.allow);
+        break;
+    default:
+        reply.error(404);
+        break;
+    }
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "Router.h"
+
+// A response as an endpoint builds it, for either engine to send: a status, a
+// content type and the body as a list of pieces. Pieces added with add() are
+// referenced, not copied, so they must outlive the reply; append() copies into
+// the reply's own buffer. Replies are reused per thread and stop allocating
+// once their buffers have grown.
+class Reply
+{
+public:
+    Reply();
+
+    void reset();
+
+    void setStatus(int status);
+    int status() const { return status_; }
+    // "OK", "Not Found", ... for the statuses the server uses.
+    const char *reason() const;
+
+    // Both must be static strings.
+    void setContentType(const char *contentType) { contentType_ = contentType; }
+    const char *contentType() const { return contentType_; }
+    void setAllow(const char *allow) { allow_ = allow; }
+    const char *allow() const { return allow_; } // null unless 405
+    // Set by endpoints whose reply depends on a request header.
+    void setVary(const char *vary) { vary_ = vary; }
+    const char *vary() const { return vary_; }
+
+    void add(const char *data, std::size_t length);
+    void add(const std::string &text) { add(text.data(), text.size()); }
+    void append(const char *data, std::size_t length);
+    void append(const char *text) { append(text, std::char_traits<char>::length(text)); }
+    void appendNumber(std::size_t value);
+
+    // Replaces the reply with a plain-text error, "404 Not Found\n" and so on.
+    void error(int status, const char *allow = nullptr);
+
+    std::size_t contentLength() const { return contentLength_; }
+    std::size_t pieces() const { return pieces_.size(); }
+    const char *data(std::size_t piece) const;
+    std::size_t length(std::size_t piece) const { return pieces_[piece].length; }
+    // Whether the piece was appended, and so lasts only until reset().
+    bool owned(std::size_t piece) const { return !pieces_[piece].data; }
+
+private:
+    struct Piece
+    {
+        const char *data; // null for a range of buffer_
+        std::size_t offset;
+        std::size_t length;
+    };
+
+    int status_;
+    const char *contentType_;
+    const char *allow_;
+    const char *vary_;
+    std::string buffer_;
+    std::vector<Piece> pieces_;
+    std::size_t contentLength_;
+};
+
+// Answers the requests routed to it. Endpoints are shared by every thread of
+// both engines, so handle() must not change them. Engines call it inside an
+// Rcu::ReadGuard held until the reply is sent, so a reply may point into
+// RCU-managed data.
+class Endpoint
+{
+public:
+    // What an endpoint sees of a request. Everything points into memory the
+    // engine keeps until the reply is sent.
+    struct Request
+    {
+        Router::Method method;
+        const Router::Match &match;
+        const std::string &clientAddress;
+        const char *accept; // the Accept header, null if there's none
+        std::size_t acceptLength;
+
+        // Picks the type in `types` the Accept header rates highest, earlier
+        // ones winning ties. Returns -1 if it accepts none of them.
+        int negotiate(const char *const types[], int count) const;
+
+        // Finds `name` in the query string; `value` is left undecoded.
+        bool query(const char *name, const char *&value, std::size_t &length) const;
+    };
+
+    virtual ~Endpoint()
+    {
+    }
+
+    virtual void handle(const Request &request, Reply &reply) const = 0;
+
+    // Fills `reply` for a match that found nothing, or found an endpoint.
+    static void dispatch(const Request &request, Reply &reply);
+};
@@ -0,0 +1,105 @@
+#include "FortuneCorpus.h"
+
+// Core
+#include <Poco/Exception.h>
+#include <Poco/NumberFormatter.h>
+
+FortuneCorpus::Snapshot::Snapshot(std::unique_ptr<FortuneStore> store)
+    : store(std::move(store)), pages(*this->store), json(*this->store)
+{
+}
+
+FortuneCorpus::FortuneCorpus(const std::string &path, long reloadMilliseconds, Rcu &rcu, Poco::Logger &logger)
+    : path_(path), rcu_(rcu), logger_(logger), current_(nullptr), interval_(reloadMilliseconds)
+{
+    if (path_.empty())
+    {
+        current_ = new Snapshot(std::unique_ptr<FortuneStore>(new FortuneStore));
+        logger_.information(Poco::NumberFormatter::format(current_.load()->store->size()) + " built-in fortunes loaded");
+        return;
+    }
+
+    stamp(loaded_);
+    seen_ = loaded_;
+    current_ = new Snapshot(std::unique_ptr<FortuneStore>(new FortuneStore(path_, interval_ <= 0)));
+    logger_.information(Poco::NumberFormatter::format(current_.load()->store->size()) + " fortunes loaded from " + path_);
+
+    if (interval_ > 0)
+    {
+        thread_.setName("corpus watcher");
+        thread_.setPriority(Poco::Thread::PRIO_LOW);
+        thread_.start(*this);
+    }
+}
+
+FortuneCorpus::~FortuneCorpus()
+{
+    stop();
+    delete current_.load();
+}
+
+void FortuneCorpus::stop()
+{
+    if (thread_.isRunning())
+    {
+        stop_.set();
+        thread_.join();
+    }
+}
+
+void FortuneCorpus::run()
+{
+    while (!stop_.tryWait(interval_))
+    {
+        rcu_.reclaim();
+
+        Stamp now;
+        if (!stamp(now))
+        {
+            continue; // between an editor's delete and rename, perhaps
+        }
+        if (now != loaded_ && now == seen_)
+        {
+            loaded_ = now;
+            reload();
+        }
+        seen_ = now;
+    }
+}
+
+bool FortuneCorpus::stamp(Stamp &stamp) const
+{
+    try
+    {
+        Poco::File file(path_);
+        stamp.size = file.getSize();
+        stamp.modified = file.getLastModified();
+        return true;
+    }
+    catch (const Poco::Exception &)
+    {
+        return false;
+    }
+}
+
+bool FortuneCorpus::reload()
+{
+    std::unique_ptr<Snapshot> next;
+    try
+    {
+        // Read rather than mapped: the file may be rewritten in place while
+        // requests still use this snapshot.
+        next.reset(new Snapshot(std::unique_ptr<FortuneStore>(new FortuneStore(path_, false))));
+    }
+    catch (const Poco::Exception &e)
+    {
+        logger_.warning("keeping the current fortunes: " + e.displayText());
+        return false;
+    }
+
+    const std::size_t size = next->store->size();
+    rcu_.retire(current_.exchange(next.release()));
+    rcu_.reclaim();
+    logger_.information("reloaded " + Poco::NumberFormatter::format(size) + " fortunes from " + path_);
+    return true;
+}
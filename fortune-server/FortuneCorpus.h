@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+// Core
+#include <Poco/Logger.h>
+#include <Poco/Timestamp.h>
+
+// Filesystem
+#include <Poco/File.h>
+
+// Threading
+#include <Poco/Event.h>
+#include <Poco/Runnable.h>
+#include <Poco/Thread.h>
+
+#include "FortuneJson.h"
+#include "FortunePages.h"
+#include "FortuneStore.h"
+#include "Rcu.h"
+
+// The fortunes being served, with their pages and JSON, replaced as a whole
+// when the corpus file changes.
+//
+// A watcher thread checks the file's size and modification time; once a
+// change has held still for a whole interval, so a file being written isn't
+// read half-way, it builds a new Snapshot and publishes it with one atomic
+// pointer swap. Requests already running carry on with the snapshot they
+// started with, which the Rcu domain frees once the last of them has finished.
+// Building, swapping and freeing all happen on the watcher thread, so request
+// threads never wait for a reload. A file that fails to load is logged and the
+// current snapshot stays.
+class FortuneCorpus : public Poco::Runnable
+{
+public:
+    struct Snapshot
+    {
+        explicit Snapshot(std::unique_ptr<FortuneStore> store);
+
+        std::unique_ptr<FortuneStore> store;
+        FortunePages pages;
+        FortuneJson json;
+    };
+
+    // Loads `path`, or the built-in fortunes if it's empty, and checks the
+    // file for changes every `reloadMilliseconds`, or never if that's 0. A
+    // file that isn't watched is mapped; one that is is read in, as it may be
+    // rewritten under the store. Throws as FortuneStore does.
+    FortuneCorpus(const std::string &path, long reloadMilliseconds, Rcu &rcu, Poco::Logger &logger);
+    ~FortuneCorpus();
+
+    // The snapshot being served. The caller must hold an Rcu::ReadGuard for as
+    // long as it uses it, and should call this once per request so everything
+    // in a reply comes from the same snapshot.
+    const Snapshot &current() const { return *current_.load(); }
+
+private:
+    FortuneCorpus(const FortuneCorpus &);
+    FortuneCorpus &operator=(const FortuneCorpus &);
+
+    struct Stamp
+    {
+        Poco::File::FileSize size = 0;
+        Poco::Timestamp modified;
+
+        bool operator==(const Stamp &other) const { return size == other.size && modified == other.modified; }
+        bool operator!=(const Stamp &other) const { return !(*this == other); }
+    };
+
+    void run() override;
+    bool stamp(Stamp &stamp) const;
+    void stop();
+
+    // Builds and publishes a new snapshot. Returns false, having logged why,
+    // if the file couldn't be loaded.
+    bool reload();
+
+    const std::string path_;
+    Rcu &rcu_;
+    Poco::Logger &logger_;
+    std::atomic<const Snapshot *> current_;
+    Stamp loaded_; // the file as last loaded, or tried
+    Stamp seen_; // the file at the last check
+    long interval_;
+    Poco::Event stop_;
+    Poco::Thread thread_;
+};
@@ -0,0 +1,178 @@
+#include "FortuneEndpoints.h"
+
+#include "JsonWriter.h"
+
+namespace
+{
+    // Parses decimal digits, refusing anything above `limit`.
+    bool ParseNumber(const char *text, std::size_t length, std::size_t limit, std::size_t &value)
+    {
+        if (length == 0)
+        {
+            return false;
+        }
+        value = 0;
+        for (std::size_t i = 0; i < length; ++i)
+        {
+            if (text[i] < '0' || text[i] > '9')
+            {
+                return false;
+            }
+            value = value * 10 + static_cast<std::size_t>(text[i] - '0');
+            if (value > limit)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // The store trims each fortune's trailing newlines.
+    const char NEWLINE[] = "\n";
+    const char SEPARATOR[] = "%\n";
+
+    const char *const PAGE_TYPES[] = {FortunePages::contentType(), FortuneJson::contentType()};
+
+    void WriteFortune(JsonWriter &writer, const FortuneJson &json, std::size_t fortune)
+    {
+        const FortuneJson::Text text = json.at(fortune);
+        writer.beginObject();
+        writer.name("id");
+        writer.value(fortune);
+        writer.name("text");
+        writer.escaped(text.json, text.length);
+        writer.endObject();
+    }
+}
+
+PageEndpoint::PageEndpoint(const FortuneCorpus &corpus, bool byId) : corpus_(corpus), byId_(byId)
+{
+}
+
+void PageEndpoint::handle(const Request &request, Reply &reply) const
+{
+    const FortuneCorpus::Snapshot &snapshot = corpus_.current();
+    std::size_t fortune = 0;
+    if (!byId_)
+    {
+        fortune = snapshot.store->randomIndex();
+    }
+    else if (!ParseNumber(request.match.parameters[0].data, request.match.parameters[0].length, snapshot.pages.size() - 1, fortune))
+    {
+        reply.error(404);
+        return;
+    }
+
+    const int type = request.negotiate(PAGE_TYPES, 2);
+    if (type < 0)
+    {
+        reply.error(406);
+        return;
+    }
+    reply.setVary("Accept");
+    reply.setContentType(PAGE_TYPES[type]);
+    if (type == 1)
+    {
+        JsonWriter writer(reply);
+        WriteFortune(writer, snapshot.json, fortune);
+        return;
+    }
+
+    const FortunePages::Page page = snapshot.pages.at(fortune);
+    reply.add(page.head, page.length);
+    reply.add(request.clientAddress);
+    reply.add(FortunePages::tail());
+}
+
+RandomFortunesEndpoint::RandomFortunesEndpoint(const FortuneCorpus &corpus) : corpus_(corpus)
+{
+}
+
+void RandomFortunesEndpoint::handle(const Request &request, Reply &reply) const
+{
+    std::size_t count = 1;
+    const char *value;
+    std::size_t length;
+    if (request.query("n", value, length) && !ParseNumber(value, length, MAX_COUNT, count))
+    {
+        reply.error(400);
+        return;
+    }
+
+    const FortuneStore &store = *corpus_.current().store;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const FortuneStore::Fortune fortune = store.random();
+        if (i > 0)
+        {
+            reply.add(SEPARATOR, sizeof(SEPARATOR) - 1);
+        }
+        reply.add(fortune.text, fortune.length);
+        reply.add(NEWLINE, 1);
+    }
+}
+
+JsonFortunesEndpoint::JsonFortunesEndpoint(const FortuneCorpus &corpus) : corpus_(corpus)
+{
+}
+
+void JsonFortunesEndpoint::handle(const Request &request, Reply &reply) const
+{
+    const char *const types[] = {FortuneJson::contentType()};
+    if (request.negotiate(types, 1) < 0)
+    {
+        reply.error(406);
+        return;
+    }
+
+    std::size_t count = 1;
+    const char *value;
+    std::size_t length;
+    if (request.query("count", value, length) && !ParseNumber(value, length, MAX_COUNT, count))
+    {
+        reply.error(400);
+        return;
+    }
+
+    const FortuneCorpus::Snapshot &snapshot = corpus_.current();
+    reply.setContentType(FortuneJson::contentType());
+    JsonWriter writer(reply);
+    writer.beginObject();
+    writer.name("fortunes");
+    writer.beginArray();
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        WriteFortune(writer, snapshot.json, snapshot.store->randomIndex());
+    }
+    writer.endArray();
+    writer.endObject();
+}
+
+MetricsEndpoint::MetricsEndpoint(const Metrics &metrics) : metrics_(metrics)
+{
+}
+
+void MetricsEndpoint::handle(const Request &, Reply &reply) const
+{
+    // Scrapes are rare; the text is kept per thread only to save regrowing it.
+    static thread_local std::string text;
+    text.clear();
+    metrics_.write(text);
+    reply.setContentType(Metrics::contentType());
+    reply.append(text.data(), text.size());
+}
+
+FortuneRoutes::FortuneRoutes(const FortuneCorpus &corpus, const Metrics &metrics)
+    : randomPage_(corpus, false),
+      page_(corpus, true),
+      random_(corpus),
+      api_(corpus),
+      metrics_(metrics)
+{
+    const unsigned read = Router::GET | Router::HEAD;
+    router_.add(read, "/", randomPage_);
+    router_.add(read, "/fortune/{id}", page_);
+    router_.add(read, "/random", random_);
+    router_.add(read, "/api/fortune", api_);
+    router_.add(read, "/metrics", metrics_);
+}
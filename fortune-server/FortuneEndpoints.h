@@ -0,0 +1,85 @@
+#pragma once
+
+#include "Endpoint.h"
+#include "FortuneCorpus.h"
+#include "Metrics.h"
+
+// A fortune as its HTML page, or as {"id": ..., "text": ...} if the Accept
+// header prefers JSON.
+class PageEndpoint : public Endpoint
+{
+public:
+    // With `byId`, the fortune is the route's first parameter; otherwise
+    // random.
+    PageEndpoint(const FortuneCorpus &corpus, bool byId);
+
+    void handle(const Request &request, Reply &reply) const override;
+
+private:
+    const FortuneCorpus &corpus_;
+    bool byId_;
+};
+
+// {"fortunes": [{"id": ..., "text": ...}, ...]} with `count` random fortunes.
+class JsonFortunesEndpoint : public Endpoint
+{
+public:
+    static const std::size_t MAX_COUNT = 10000;
+
+    explicit JsonFortunesEndpoint(const FortuneCorpus &corpus);
+
+    void handle(const Request &request, Reply &reply) const override;
+
+private:
+    const FortuneCorpus &corpus_;
+};
+
+class RandomFortunesEndpoint : public Endpoint
+{
+public:
+    static const std::size_t MAX_COUNT = 1000;
+
+    explicit RandomFortunesEndpoint(const FortuneCorpus &corpus);
+
+    void handle(const Request &request, Reply &reply) const override;
+
+private:
+    const FortuneCorpus &corpus_;
+};
+
+class MetricsEndpoint : public Endpoint
+{
+public:
+    explicit MetricsEndpoint(const Metrics &metrics);
+
+    void handle(const Request &request, Reply &reply) const override;
+
+private:
+    const Metrics &metrics_;
+};
+
+// The routes the server answers, all for GET and HEAD:
+//
+//   /                        a random fortune's page, or JSON
+//   /fortune/{id}            fortune `id`'s page or JSON, counting from 0
+//   /random?n=10             n random fortunes as text, '%' lines between them
+//   /api/fortune?count=10    count random fortunes as JSON
+//   /metrics                 counters and latencies for Prometheus
+class FortuneRoutes
+{
+public:
+    FortuneRoutes(const FortuneCorpus &corpus, const Metrics &metrics);
+
+    const Router &router() const { return router_; }
+
+private:
+    FortuneRoutes(const FortuneRoutes &);
+    FortuneRoutes &operator=(const FortuneRoutes &);
+
+    PageEndpoint randomPage_;
+    PageEndpoint page_;
+    RandomFortunesEndpoint random_;
+    JsonFortunesEndpoint api_;
+    MetricsEndpoint metrics_;
+    Router router_;
+};
@@ -0,0 +1,29 @@
+#include "FortuneJson.h"
+
+#include "JsonWriter.h"
+
+FortuneJson::FortuneJson(const FortuneStore &store)
+{
+    std::size_t total = 0;
+    for (std::size_t i = 0; i < store.size(); ++i)
+    {
+        total += store.at(i).length + 2;
+    }
+    arena_.reserve(total + total / 8);
+
+    offsets_.reserve(store.size() + 1);
+    offsets_.push_back(0);
+    for (std::size_t i = 0; i < store.size(); ++i)
+    {
+        const FortuneStore::Fortune fortune = store.at(i);
+        JsonWriter::escape(fortune.text, fortune.length, arena_);
+        offsets_.push_back(arena_.size());
+    }
+}
+
+FortuneJson::Text FortuneJson::at(std::size_t i) const
+{
+    const std::size_t offset = offsets_.at(i);
+    Text text = {arena_.data() + offset, offsets_[i + 1] - offset};
+    return text;
+}
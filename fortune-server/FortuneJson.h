@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "FortuneStore.h"
+
+// Every fortune as a quoted, escaped JSON string, prepared once at startup so
+// JsonWriter can reference them instead of escaping per request.
+class FortuneJson
+{
+public:
+    struct Text
+    {
+        const char *json;
+        std::size_t length;
+    };
+
+    explicit FortuneJson(const FortuneStore &store);
+
+    std::size_t size() const { return offsets_.size() - 1; }
+    Text at(std::size_t i) const;
+
+    static const char *contentType() { return "application/json"; }
+
+private:
+    FortuneJson(const FortuneJson &);
+    FortuneJson &operator=(const FortuneJson &);
+
+    std::string arena_;
+    std::vector<std::size_t> offsets_; // fortune i is [offsets_[i], offsets_[i + 1])
+};
@@ -0,0 +1,97 @@
+#include "FortunePages.h"
+
+namespace
+{
+    const char PAGE_HEAD[] =
+        "<html>"
+        "<head>"
+        "<title>Fortunes</title>"
+        "</head>"
+        "<body>"
+        "<p style=\"text-align: center; font-size: 48px; white-space: pre-line;\">";
+
+    const char PAGE_MIDDLE[] =
+        "</p>"
+        "<p style=\"text-align: left; font-size: 12px;\">"
+        "Client address: ";
+
+    const char PAGE_TAIL[] =
+        "</p>"
+        "</body>"
+        "</html>";
+
+    // Corpus files are plain text, so markup characters are written as
+    // entities.
+    void AppendEscaped(std::string &out, const FortuneStore::Fortune &fortune)
+    {
+        const char *run = fortune.text;
+        const char *const end = fortune.text + fortune.length;
+        for (const char *p = run; p < end; ++p)
+        {
+            const char *entity;
+            switch (*p)
+            {
+            case '<':
+                entity = "&lt;";
+                break;
+            case '>':
+                entity = "&gt;";
+                break;
+            case '&':
+                entity = "&amp;";
+                break;
+            case '"':
+                entity = "&quot;";
+                break;
+            default:
+                continue;
+            }
+            out.append(run, p - run);
+            out.append(entity);
+            run = p + 1;
+        }
+        out.append(run, end - run);
+    }
+}
+
+FortunePages::FortunePages(const FortuneStore &store)
+{
+    std::size_t total = 0;
+    for (std::size_t i = 0; i < store.size(); ++i)
+    {
+        total += sizeof(PAGE_HEAD) - 1 + store.at(i).length + sizeof(PAGE_MIDDLE) - 1;
+    }
+    arena_.reserve(total);
+
+    offsets_.reserve(store.size() + 1);
+    offsets_.push_back(0);
+    for (std::size_t i = 0; i < store.size(); ++i)
+    {
+        arena_.append(PAGE_HEAD, sizeof(PAGE_HEAD) - 1);
+        AppendEscaped(arena_, store.at(i));
+        arena_.append(PAGE_MIDDLE, sizeof(PAGE_MIDDLE) - 1);
+        offsets_.push_back(arena_.size());
+    }
+}
+
+FortunePages::Page FortunePages::at(std::size_t i) const
+{
+    const std::size_t offset = offsets_.at(i);
+    Page page = {arena_.data() + offset, offsets_[i + 1] - offset};
+    return page;
+}
+
+const std::string &FortunePages::tail()
+{
+    static const std::string tail(PAGE_TAIL, sizeof(PAGE_TAIL) - 1);
+    return tail;
+}
+
+void FortunePages::render(std::size_t i, const std::string &clientAddress, std::string &body) const
+{
+    const Page page = at(i);
+    body.reserve(body.size() + page.length + clientAddress.size() + tail().size());
+    body.append(page.head, page.length);
+    body.append(clientAddress);
+    body.append(tail());
+}
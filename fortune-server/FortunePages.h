@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "FortuneStore.h"
+
+// Every fortune's HTML page, rendered once at startup.
+//
+// A page is the same for every request except for the client's address near
+// the end, so each is stored up to that point in one arena; a response is the
+// page's head, the address and the shared tail(). With a fixed Content-Length
+// that's three copies into a send buffer, or a single writev(), instead of
+// formatting the page through an ostream with chunked framing.
+class FortunePages
+{
+public:
+    struct Page
+    {
+        const char *head;
+        std::size_t length;
+    };
+
+    explicit FortunePages(const FortuneStore &store);
+
+    std::size_t size() const { return offsets_.size() - 1; }
+    Page at(std::size_t i) const;
+
+    // Everything after the client address.
+    static const std::string &tail();
+
+    // Appends the page with `clientAddress` filled in to `body`.
+    void render(std::size_t i, const std::string &clientAddress, std::string &body) const;
+
+    static const char *contentType() { return "text/html"; }
+
+private:
+    FortunePages(const FortunePages &);
+    FortunePages &operator=(const FortunePages &);
+
+    std::string arena_;
+    std::vector<std::size_t> offsets_; // page i is [offsets_[i], offsets_[i + 1])
+};
@@ -0,0 +1,152 @@
+#include "FortuneStore.h"
+
+#include <cstring>
+#include <limits>
+
+// Core
+#include <Poco/Exception.h>
+
+// Crypt
+#include <Poco/Random.h>
+
+// Filesystem
+#include <Poco/File.h>
+
+// Streams
+#include <Poco/FileStream.h>
+
+namespace
+{
+    const char *const BUILT_IN_FORTUNES =
+        "The first principle is that you must not fool yourself -- and you are the easiest person to fool. -- Richard Feynman\n"
+        "%\n"
+        "The greater danger for most of us lies not in setting our aim too high and falling short; but in setting our aim too low, and achieving our mark. -- Michelangelo\n"
+        "%\n"
+        "A friend is someone who understands your past, believes in your future, and accepts you just the way you are.\n"
+        "%\n"
+        "Be kind, for everyone you meet is fighting a hard battle. -- Plato\n"
+        "%\n"
+        "Happiness is when what you think, what you say, and what you do are in harmony. -- Gandhi\n"
+        "%\n"
+        "We must accept finite disappointment, but never lose infinite hope. -- Martin Luther King Jr.\n";
+
+    // Seeded once per thread from the system's entropy source rather than the
+    // clock, so threads started together don't draw the same sequence.
+    Poco::Random &ThreadRandom()
+    {
+        struct SeededRandom : public Poco::Random
+        {
+            SeededRandom() { seed(); }
+        };
+        static thread_local SeededRandom random;
+        return random;
+    }
+
+    bool IsDelimiter(const char *line, std::size_t length)
+    {
+        return (length == 1 && line[0] == '%') || (length == 2 && line[0] == '%' && line[1] == '\r');
+    }
+
+    bool IsBlank(const char *text, std::size_t length)
+    {
+        for (std::size_t i = 0; i < length; ++i)
+        {
+            if (text[i] != ' ' && text[i] != '\t' && text[i] != '\r' && text[i] != '\n')
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+FortuneStore::FortuneStore() : contents_(BUILT_IN_FORTUNES), data_(contents_.data()), dataSize_(contents_.size())
+{
+    buildIndex();
+}
+
+FortuneStore::FortuneStore(const std::string &path, bool map) : data_(nullptr), dataSize_(0)
+{
+    Poco::File file(path);
+    const Poco::File::FileSize size = file.getSize();
+    if (size == 0)
+    {
+        throw Poco::DataFormatException("no fortunes in", path);
+    }
+    if (size > std::numeric_limits<Poco::UInt32>::max())
+    {
+        throw Poco::DataFormatException("fortune file larger than 4 GB", path);
+    }
+
+    if (map)
+    {
+        Poco::SharedMemory(file, Poco::SharedMemory::AM_READ).swap(mapping_);
+        data_ = mapping_.begin();
+        dataSize_ = static_cast<std::size_t>(size);
+    }
+    else
+    {
+        // A mapping would change under the store, or fault, if the file were
+        // truncated and rewritten.
+        Poco::FileInputStream in(path);
+        contents_.resize(static_cast<std::size_t>(size));
+        in.read(&contents_[0], static_cast<std::streamsize>(contents_.size()));
+        contents_.resize(static_cast<std::size_t>(in.gcount()));
+        data_ = contents_.data();
+        dataSize_ = contents_.size();
+    }
+
+    buildIndex();
+    if (index_.empty())
+    {
+        throw Poco::DataFormatException("no fortunes in", path);
+    }
+}
+
+FortuneStore::Fortune FortuneStore::at(std::size_t i) const
+{
+    const Entry &entry = index_.at(i);
+    Fortune fortune = {data_ + entry.offset, entry.length};
+    return fortune;
+}
+
+FortuneStore::Fortune FortuneStore::random() const
+{
+    return at(randomIndex());
+}
+
+std::size_t FortuneStore::randomIndex() const
+{
+    return ThreadRandom().next(static_cast<Poco::UInt32>(index_.size()));
+}
+
+// One pass over the file, a line at a time. Each fortune ends at a delimiter
+// line or the end of the file and loses its final line break; blank ones are
+// skipped.
+void FortuneStore::buildIndex()
+{
+    const char *const end = data_ + dataSize_;
+    const char *start = data_;
+    const char *line = data_;
+    while (line < end)
+    {
+        const char *newline = static_cast<const char *>(std::memchr(line, '\n', end - line));
+        const char *next = newline ? newline + 1 : end;
+        const bool delimiter = IsDelimiter(line, (newline ? newline : end) - line);
+        if (delimiter || next == end)
+        {
+            const char *stop = delimiter ? line : end;
+            while (stop > start && (stop[-1] == '\n' || stop[-1] == '\r'))
+            {
+                --stop;
+            }
+            if (!IsBlank(start, stop - start))
+            {
+                Entry entry = {static_cast<Poco::UInt32>(start - data_), static_cast<Poco::UInt32>(stop - start)};
+                index_.push_back(entry);
+            }
+            start = next;
+        }
+        line = next;
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Core
+#include <Poco/Types.h>
+
+// Filesystem
+#include <Poco/SharedMemory.h>
+
+// A read-only fortune corpus, loaded once and shared by every request thread.
+//
+// The file is a strfile(1) style database: fortunes separated by lines holding
+// a single '%'. It's memory-mapped and indexed by offset at load time, so
+// picking a fortune costs the same however many there are, and nothing is
+// copied per request.
+class FortuneStore
+{
+public:
+    // A fortune's text, pointing into the store.
+    struct Fortune
+    {
+        const char *text;
+        std::size_t length;
+    };
+
+    // The handful of fortunes built into the server.
+    FortuneStore();
+
+    // Maps and indexes `path`, or reads it into memory if `map` is false, for
+    // a file that may be rewritten while the store is in use. Throws
+    // Poco::FileException if it can't be read and Poco::DataFormatException if
+    // it holds no fortunes.
+    explicit FortuneStore(const std::string &path, bool map = true);
+
+    std::size_t size() const { return index_.size(); }
+    Fortune at(std::size_t i) const;
+
+    // A fortune chosen with a generator private to the calling thread.
+    Fortune random() const;
+    std::size_t randomIndex() const;
+
+private:
+    FortuneStore(const FortuneStore &);
+    FortuneStore &operator=(const FortuneStore &);
+
+    struct Entry
+    {
+        Poco::UInt32 offset;
+        Poco::UInt32 length;
+    };
+
+    void buildIndex();
+
+    Poco::SharedMemory mapping_;
+    std::string contents_; // the built-in fortunes, or a file read in
+    const char *data_;
+    std::size_t dataSize_;
+    std::vector<Entry> index_;
+};
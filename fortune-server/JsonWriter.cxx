@@ -0,0 +1,171 @@
+#include "JsonWriter.h"
+
+#include <cstdio>
+
+namespace
+{
+    // The length of the well-formed UTF-8 sequence at `p`, or 0 if there's
+    // none there: overlong forms, surrogates and code points past U+10FFFF
+    // are all rejected, as RFC 3629 has it.
+    std::size_t Utf8Length(const unsigned char *p, const unsigned char *end)
+    {
+        std::size_t length;
+        unsigned char low = 0x80;
+        unsigned char high = 0xBF;
+        if (p[0] >= 0xC2 && p[0] <= 0xDF)
+        {
+            length = 2;
+        }
+        else if (p[0] >= 0xE0 && p[0] <= 0xEF)
+        {
+            length = 3;
+            low = p[0] == 0xE0 ? 0xA0 : 0x80;
+            high = p[0] == 0xED ? 0x9F : 0xBF;
+        }
+        else if (p[0] >= 0xF0 && p[0] <= 0xF4)
+        {
+            length = 4;
+            low = p[0] == 0xF0 ? 0x90 : 0x80;
+            high = p[0] == 0xF4 ? 0x8F : 0xBF;
+        }
+        else
+        {
+            return 0;
+        }
+
+        if (static_cast<std::size_t>(end - p) < length || p[1] < low || p[1] > high)
+        {
+            return 0;
+        }
+        for (std::size_t i = 2; i < length; ++i)
+        {
+            if (p[i] < 0x80 || p[i] > 0xBF)
+            {
+                return 0;
+            }
+        }
+        return length;
+    }
+}
+
+JsonWriter::JsonWriter(Reply &reply) : reply_(reply), first_(true), named_(false)
+{
+}
+
+void JsonWriter::beginObject()
+{
+    separate();
+    reply_.append("{");
+    first_ = true;
+}
+
+void JsonWriter::endObject()
+{
+    reply_.append("}");
+    first_ = false;
+}
+
+void JsonWriter::beginArray()
+{
+    separate();
+    reply_.append("[");
+    first_ = true;
+}
+
+void JsonWriter::endArray()
+{
+    reply_.append("]");
+    first_ = false;
+}
+
+void JsonWriter::name(const char *name)
+{
+    separate();
+    reply_.append("\"");
+    reply_.append(name);
+    reply_.append("\":");
+    named_ = true;
+}
+
+void JsonWriter::value(std::size_t number)
+{
+    separate();
+    reply_.appendNumber(number);
+}
+
+void JsonWriter::escaped(const char *json, std::size_t length)
+{
+    separate();
+    reply_.add(json, length);
+}
+
+void JsonWriter::escape(const char *text, std::size_t length, std::string &out)
+{
+    out += '"';
+    const char *run = text;
+    const char *const end = text + length;
+    for (const char *p = run; p < end; ++p)
+    {
+        const unsigned char c = static_cast<unsigned char>(*p);
+        if (c >= 0x80)
+        {
+            // Bytes that aren't UTF-8 would make the document invalid; each
+            // becomes U+FFFD.
+            const std::size_t sequence = Utf8Length(reinterpret_cast<const unsigned char *>(p), reinterpret_cast<const unsigned char *>(end));
+            if (sequence > 0)
+            {
+                p += sequence - 1;
+                continue;
+            }
+            out.append(run, p - run);
+            out += "\xEF\xBF\xBD";
+            run = p + 1;
+            continue;
+        }
+        if (c >= 0x20 && c != '"' && c != '\\')
+        {
+            continue;
+        }
+
+        out.append(run, p - run);
+        run = p + 1;
+        switch (c)
+        {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\r':
+            out += "\\r";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        default:
+            char unicode[8];
+            std::snprintf(unicode, sizeof(unicode), "\\u%04x", c);
+            out += unicode;
+            break;
+        }
+    }
+    out.append(run, end - run);
+    out += '"';
+}
+
+void JsonWriter::separate()
+{
+    if (named_)
+    {
+        named_ = false;
+    }
+    else if (!first_)
+    {
+        reply_.append(",");
+    }
+    first_ = false;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+
+#include "Endpoint.h"
+
+// Writes JSON into a Reply as it goes, rather than building a tree first.
+// Punctuation and numbers are appended to the reply's buffer; strings escaped
+// ahead of time are referenced where they lie, so a long array of fortunes
+// costs little more than the writev() that sends it.
+//
+// Names are written as given and must not need escaping. The writer doesn't
+// check that begin and end calls pair up.
+class JsonWriter
+{
+public:
+    explicit JsonWriter(Reply &reply);
+
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+
+    void name(const char *name);
+
+    void value(std::size_t number);
+
+    // A string already quoted and escaped by escape(), which must outlive the
+    // reply.
+    void escaped(const char *json, std::size_t length);
+
+    // Appends `text` to `out` as a quoted JSON string. Bytes that aren't
+    // part of well-formed UTF-8 become U+FFFD.
+    static void escape(const char *text, std::size_t length, std::string &out);
+
+private:
+    void separate();
+
+    Reply &reply_;
+    bool first_; // nothing written yet in the current object or array
+    bool named_; // a name was written, its value hasn't
+};
@@ -0,0 +1,319 @@
+#include "Metrics.h"
+
+// Core
+#include <Poco/NumberFormatter.h>
+
+namespace
+{
+    // Statuses counted separately; anything else is "other".
+    const int STATUSES[] = {200, 400, 404, 405, 406, 431, 500, 501, 503};
+    const unsigned STATUS_COUNT = sizeof(STATUSES) / sizeof(STATUSES[0]);
+
+    const double QUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+    const char *const QUANTILE_LABELS[] = {"0.5", "0.9", "0.99", "0.999"};
+
+    // Only the owning thread writes a shard, so a plain load and store do.
+    void Bump(std::atomic<Poco::UInt64> &counter, Poco::UInt64 amount)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    unsigned HighestBit(Poco::UInt64 value)
+    {
+        unsigned bit = 0;
+        while (value >>= 1)
+        {
+            ++bit;
+        }
+        return bit;
+    }
+
+    // Microseconds as seconds, without going through floating point.
+    void AppendSeconds(std::string &out, Poco::UInt64 microseconds)
+    {
+        Poco::NumberFormatter::append(out, microseconds / 1000000);
+        Poco::UInt64 fraction = microseconds % 1000000;
+        if (fraction == 0)
+        {
+            return;
+        }
+        char digits[7] = {'.', '0', '0', '0', '0', '0', '0'};
+        for (int i = 6; i > 0; --i)
+        {
+            digits[i] = static_cast<char>('0' + fraction % 10);
+            fraction /= 10;
+        }
+        std::size_t length = 7;
+        while (digits[length - 1] == '0')
+        {
+            --length;
+        }
+        out.append(digits, length);
+    }
+
+    void AppendHeader(std::string &out, const std::string &name, const std::string &help, const char *type)
+    {
+        out += "# HELP ";
+        out += name;
+        out += ' ';
+        out += help;
+        out += "\n# TYPE ";
+        out += name;
+        out += ' ';
+        out += type;
+        out += '\n';
+    }
+}
+
+// Padded on both sides so no other shard, or anything else, shares its cache
+// lines.
+struct Metrics::Shard
+{
+    char before[64];
+    std::atomic<Poco::UInt64> statuses[STATUS_COUNT + 1];
+    std::atomic<Poco::UInt64> buckets[BUCKETS];
+    std::atomic<Poco::UInt64> microseconds;
+    char after[64];
+
+    Shard()
+    {
+        for (auto &counter : statuses)
+        {
+            counter.store(0, std::memory_order_relaxed);
+        }
+        for (auto &counter : buckets)
+        {
+            counter.store(0, std::memory_order_relaxed);
+        }
+        microseconds.store(0, std::memory_order_relaxed);
+    }
+};
+
+// The calling thread's shard, handed back when the thread exits.
+struct Metrics::Holder
+{
+    Metrics *metrics = nullptr;
+    Shard *shard = nullptr;
+
+    ~Holder()
+    {
+        if (metrics)
+        {
+            metrics->release(shard);
+        }
+    }
+};
+
+thread_local Metrics::Holder Metrics::holder_;
+
+Metrics::Metrics()
+{
+}
+
+Metrics::~Metrics()
+{
+}
+
+void Metrics::record(int status, Poco::UInt64 microseconds)
+{
+    Shard &shard = this->shard();
+    count(shard, status);
+    Bump(shard.buckets[bucketOf(microseconds)], 1);
+    Bump(shard.microseconds, microseconds);
+}
+
+void Metrics::record(int status)
+{
+    count(shard(), status);
+}
+
+void Metrics::count(Shard &shard, int status)
+{
+    unsigned i = 0;
+    while (i < STATUS_COUNT && STATUSES[i] != status)
+    {
+        ++i;
+    }
+    Bump(shard.statuses[i], 1);
+}
+
+void Metrics::addGauge(const std::string &name, const std::string &help, const Reading &reading)
+{
+    Poco::FastMutex::ScopedLock lock(mutex_);
+    Value value = {name, help, "gauge", reading};
+    values_.push_back(value);
+}
+
+void Metrics::addCounter(const std::string &name, const std::string &help, const Reading &reading)
+{
+    Poco::FastMutex::ScopedLock lock(mutex_);
+    Value value = {name, help, "counter", reading};
+    values_.push_back(value);
+}
+
+void Metrics::removeReadings()
+{
+    Poco::FastMutex::ScopedLock lock(mutex_);
+    values_.clear();
+}
+
+void Metrics::write(std::string &out) const
+{
+    Poco::UInt64 statuses[STATUS_COUNT + 1] = {};
+    Poco::UInt64 buckets[BUCKETS] = {};
+    Poco::UInt64 microseconds = 0;
+    Poco::FastMutex::ScopedLock lock(mutex_);
+    for (const auto &shard : shards_)
+    {
+        for (unsigned i = 0; i <= STATUS_COUNT; ++i)
+        {
+            statuses[i] += shard->statuses[i].load(std::memory_order_relaxed);
+        }
+        for (unsigned i = 0; i < BUCKETS; ++i)
+        {
+            buckets[i] += shard->buckets[i].load(std::memory_order_relaxed);
+        }
+        microseconds += shard->microseconds.load(std::memory_order_relaxed);
+    }
+
+    AppendHeader(out, "fortune_requests_total", "Requests answered, by status.", "counter");
+    for (unsigned i = 0; i <= STATUS_COUNT; ++i)
+    {
+        out += "fortune_requests_total{code=\"";
+        if (i < STATUS_COUNT)
+        {
+            Poco::NumberFormatter::append(out, STATUSES[i]);
+        }
+        else
+        {
+            out += "other";
+        }
+        out += "\"} ";
+        Poco::NumberFormatter::append(out, statuses[i]);
+        out += '\n';
+    }
+
+    Poco::UInt64 count = 0;
+    for (Poco::UInt64 bucket : buckets)
+    {
+        count += bucket;
+    }
+    AppendHeader(out, "fortune_request_duration_seconds", "Time spent handling a request.", "histogram");
+    Poco::UInt64 below = 0;
+    unsigned next = 0;
+    for (unsigned octave = 0; octave < OCTAVES; ++octave)
+    {
+        const Poco::UInt64 limit = static_cast<Poco::UInt64>(1) << octave;
+        // Every bucket before the one that holds limit + 1 is at or below it.
+        for (const unsigned end = bucketOf(limit + 1); next < end; ++next)
+        {
+            below += buckets[next];
+        }
+        out += "fortune_request_duration_seconds_bucket{le=\"";
+        AppendSeconds(out, limit);
+        out += "\"} ";
+        Poco::NumberFormatter::append(out, below);
+        out += '\n';
+    }
+    out += "fortune_request_duration_seconds_bucket{le=\"+Inf\"} ";
+    Poco::NumberFormatter::append(out, count);
+    out += "\nfortune_request_duration_seconds_sum ";
+    AppendSeconds(out, microseconds);
+    out += "\nfortune_request_duration_seconds_count ";
+    Poco::NumberFormatter::append(out, count);
+    out += '\n';
+
+    // The same histogram read back as quantiles, each the top of its bucket.
+    AppendHeader(out, "fortune_request_latency_seconds", "Request handling time quantiles.", "summary");
+    for (unsigned q = 0; q < sizeof(QUANTILES) / sizeof(QUANTILES[0]); ++q)
+    {
+        const Poco::UInt64 rank = static_cast<Poco::UInt64>(QUANTILES[q] * static_cast<double>(count));
+        Poco::UInt64 seen = 0;
+        unsigned bucket = 0;
+        while (bucket + 1 < BUCKETS && seen + buckets[bucket] <= rank)
+        {
+            seen += buckets[bucket++];
+        }
+        out += "fortune_request_latency_seconds{quantile=\"";
+        out += QUANTILE_LABELS[q];
+        out += "\"} ";
+        AppendSeconds(out, count ? bucketLimit(bucket) : 0);
+        out += '\n';
+    }
+    out += "fortune_request_latency_seconds_sum ";
+    AppendSeconds(out, microseconds);
+    out += "\nfortune_request_latency_seconds_count ";
+    Poco::NumberFormatter::append(out, count);
+    out += '\n';
+
+    for (const Value &value : values_)
+    {
+        AppendHeader(out, value.name, value.help, value.type);
+        out += value.name;
+        out += ' ';
+        Poco::NumberFormatter::append(out, value.reading());
+        out += '\n';
+    }
+}
+
+unsigned Metrics::bucketOf(Poco::UInt64 microseconds)
+{
+    // Shifted down by one, so each bucket's top is inclusive, as "le" is.
+    microseconds = microseconds > 0 ? microseconds - 1 : 0;
+    if (microseconds < SUB_BUCKETS)
+    {
+        return static_cast<unsigned>(microseconds);
+    }
+    const unsigned bit = HighestBit(microseconds);
+    if (bit >= OCTAVES)
+    {
+        return BUCKETS - 1;
+    }
+    const unsigned sub = static_cast<unsigned>(microseconds >> (bit - 3)) & (SUB_BUCKETS - 1);
+    return (bit - 2) * SUB_BUCKETS + sub;
+}
+
+// The largest value in `bucket`.
+Poco::UInt64 Metrics::bucketLimit(unsigned bucket)
+{
+    const unsigned next = bucket + 1;
+    if (next < SUB_BUCKETS)
+    {
+        return next;
+    }
+    const unsigned bit = next / SUB_BUCKETS + 2;
+    return static_cast<Poco::UInt64>(SUB_BUCKETS + next % SUB_BUCKETS) << (bit - 3);
+}
+
+Metrics::Shard &Metrics::shard()
+{
+    Holder &holder = holder_;
+    if (holder.metrics == this)
+    {
+        return *holder.shard;
+    }
+
+    if (holder.metrics)
+    {
+        holder.metrics->release(holder.shard);
+    }
+    Poco::FastMutex::ScopedLock lock(mutex_);
+    if (free_.empty())
+    {
+        shards_.emplace_back(new Shard);
+        holder.shard = shards_.back().get();
+    }
+    else
+    {
+        holder.shard = free_.back();
+        free_.pop_back();
+    }
+    holder.metrics = this;
+    return *holder.shard;
+}
+
+void Metrics::release(Shard *shard)
+{
+    Poco::FastMutex::ScopedLock lock(mutex_);
+    free_.push_back(shard);
+}
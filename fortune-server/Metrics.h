@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Core
+#include <Poco/Mutex.h>
+#include <Poco/Types.h>
+
+// Request counters and latency histograms, written out for /metrics in the
+// Prometheus text format.
+//
+// Each thread that records gets a shard of its own, so record() is a handful
+// of relaxed loads and stores to cache lines no other thread writes: no lock
+// and no contended atomic. A scrape adds the shards up. Latencies go into
+// log-linear buckets, 8 to each power of two of microseconds, so quantiles read
+// back within about 12%; the histogram is exported at each power of two.
+//
+// Gauges and counters owned elsewhere, such as the server's thread counts, are
+// read through callbacks at scrape time. A Metrics must outlive the threads
+// that record into it.
+class Metrics
+{
+public:
+    typedef std::function<Poco::Int64()> Reading;
+
+    // Measures from construction to elapsed().
+    class Timer
+    {
+    public:
+        Timer() : start_(std::chrono::steady_clock::now()) {}
+
+        Poco::UInt64 elapsed() const
+        {
+            return static_cast<Poco::UInt64>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_).count());
+        }
+
+    private:
+        std::chrono::steady_clock::time_point start_;
+    };
+
+    Metrics();
+    ~Metrics();
+
+    void record(int status, Poco::UInt64 microseconds);
+
+    // Counts a response that wasn't timed, such as one to a request that
+    // couldn't be parsed; the latency histogram is left to the rest.
+    void record(int status);
+
+    // Added before the server starts, or while it runs.
+    void addGauge(const std::string &name, const std::string &help, const Reading &reading);
+    void addCounter(const std::string &name, const std::string &help, const Reading &reading);
+
+    // Drops every gauge and counter added above, before what they read goes
+    // away. A scrape already reading them finishes first.
+    void removeReadings();
+
+    void write(std::string &out) const;
+
+    static const char *contentType() { return "text/plain; version=0.0.4"; }
+
+private:
+    Metrics(const Metrics &);
+    Metrics &operator=(const Metrics &);
+
+    static const unsigned SUB_BUCKETS = 8;
+    static const unsigned OCTAVES = 27; // up to 2^27 us, about two minutes
+    static const unsigned BUCKETS = (OCTAVES - 2) * SUB_BUCKETS;
+
+    struct Shard;
+    struct Holder;
+
+    struct Value
+    {
+        std::string name;
+        std::string help;
+        const char *type;
+        Reading reading;
+    };
+
+    static unsigned bucketOf(Poco::UInt64 microseconds);
+    static Poco::UInt64 bucketLimit(unsigned bucket);
+
+    Shard &shard();
+    static void count(Shard &shard, int status);
+    void release(Shard *shard);
+
+    mutable Poco::FastMutex mutex_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::vector<Shard *> free_; // left by threads that exited, for new ones
+    std::vector<Value> values_;
+
+    static thread_local Holder holder_;
+};
@@ -0,0 +1,130 @@
+#include "Rcu.h"
+
+// A reader thread's slot, padded so no other slot shares its cache line.
+struct Rcu::Slot
+{
+    char before[64];
+    std::atomic<Poco::UInt64> epoch; // 0 outside a guard
+    unsigned depth = 0; // nested guards; only the owner touches it
+    char after[64];
+
+    Slot() : epoch(0)
+    {
+    }
+};
+
+// The calling thread's slot, handed back when the thread exits.
+struct Rcu::Holder
+{
+    Rcu *rcu = nullptr;
+    Slot *slot = nullptr;
+
+    ~Holder()
+    {
+        if (rcu)
+        {
+            rcu->release(slot);
+        }
+    }
+};
+
+thread_local Rcu::Holder Rcu::holder_;
+
+Rcu::ReadGuard::ReadGuard(Rcu &rcu) : slot_(rcu.slot())
+{
+    // Sequentially consistent, so the slot is visible before anything the
+    // reader loads under it.
+    if (slot_.depth++ == 0)
+    {
+        slot_.epoch.store(rcu.epoch_.load());
+    }
+}
+
+Rcu::ReadGuard::~ReadGuard()
+{
+    if (--slot_.depth == 0)
+    {
+        slot_.epoch.store(0, std::memory_order_release);
+    }
+}
+
+Rcu::Rcu() : epoch_(1)
+{
+}
+
+Rcu::~Rcu()
+{
+}
+
+std::size_t Rcu::reclaim()
+{
+    Poco::FastMutex::ScopedLock lock(mutex_);
+
+    Poco::UInt64 oldest = epoch_.load();
+    for (const auto &slot : slots_)
+    {
+        const Poco::UInt64 epoch = slot->epoch.load();
+        if (epoch != 0 && epoch < oldest)
+        {
+            oldest = epoch;
+        }
+    }
+
+    // Deleted here, on the caller's thread, never a reader's.
+    auto keep = retired_.begin();
+    for (auto it = retired_.begin(); it != retired_.end(); ++it)
+    {
+        if ((*it)->epoch > oldest)
+        {
+            if (keep != it)
+            {
+                *keep = std::move(*it);
+            }
+            ++keep;
+        }
+    }
+    retired_.erase(keep, retired_.end());
+    return retired_.size();
+}
+
+void Rcu::retire(std::unique_ptr<Retired> retired)
+{
+    // The pointer was swapped before this increment, so any reader that
+    // loaded the old object entered in an earlier epoch.
+    retired->epoch = epoch_.fetch_add(1) + 1;
+    Poco::FastMutex::ScopedLock lock(mutex_);
+    retired_.push_back(std::move(retired));
+}
+
+Rcu::Slot &Rcu::slot()
+{
+    Holder &holder = holder_;
+    if (holder.rcu == this)
+    {
+        return *holder.slot;
+    }
+
+    if (holder.rcu)
+    {
+        holder.rcu->release(holder.slot);
+    }
+    Poco::FastMutex::ScopedLock lock(mutex_);
+    if (free_.empty())
+    {
+        slots_.emplace_back(new Slot);
+        holder.slot = slots_.back().get();
+    }
+    else
+    {
+        holder.slot = free_.back();
+        free_.pop_back();
+    }
+    holder.rcu = this;
+    return *holder.slot;
+}
+
+void Rcu::release(Slot *slot)
+{
+    Poco::FastMutex::ScopedLock lock(mutex_);
+    free_.push_back(slot);
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// Core
+#include <Poco/Mutex.h>
+#include <Poco/Types.h>
+
+// Deferred reclamation for data published through an atomic pointer, in the
+// manner of RCU.
+//
+// Readers hold a ReadGuard while they use what they loaded; a writer swaps the
+// pointer and retire()s the old object, and reclaim() deletes it once every
+// reader that could have seen it has left its guard. Entering and leaving a
+// guard are two stores to a slot of the reader's own; readers never wait, and
+// only a writer scans the slots.
+//
+// Each retire() starts a new epoch. A reader's slot holds the epoch in which
+// it entered, or 0 outside a guard, so an object retired in epoch e is safe to
+// delete when no slot holds a value below e.
+//
+// An Rcu must outlive the threads that read under it.
+class Rcu
+{
+    struct Slot;
+
+public:
+    class ReadGuard
+    {
+    public:
+        explicit ReadGuard(Rcu &rcu);
+        ~ReadGuard();
+
+    private:
+        ReadGuard(const ReadGuard &);
+        ReadGuard &operator=(const ReadGuard &);
+
+        Slot &slot_;
+    };
+
+    Rcu();
+    // Deletes everything retired; no reader may be left.
+    ~Rcu();
+
+    // Takes ownership of an object that's no longer published.
+    template <class T>
+    void retire(const T *object)
+    {
+        retire(std::unique_ptr<Retired>(new RetiredObject<T>(object)));
+    }
+
+    // Deletes what no reader can still hold. Returns how many are left.
+    std::size_t reclaim();
+
+private:
+    Rcu(const Rcu &);
+    Rcu &operator=(const Rcu &);
+
+    struct Retired
+    {
+        virtual ~Retired() {}
+        Poco::UInt64 epoch = 0;
+    };
+
+    template <class T>
+    struct RetiredObject : Retired
+    {
+        explicit RetiredObject(const T *object) : object(object) {}
+        std::unique_ptr<const T> object;
+    };
+
+    struct Holder;
+
+    void retire(std::unique_ptr<Retired> retired);
+    Slot &slot();
+    void release(Slot *slot);
+
+    std::atomic<Poco::UInt64> epoch_;
+    Poco::FastMutex mutex_; // slots_, free_ and retired_
+    std::vector<std::unique_ptr<Slot>> slots_;
+    std::vector<Slot *> free_; // left by threads that exited, for new ones
+    std::vector<std::unique_ptr<Retired>> retired_;
+
+    static thread_local Holder holder_;
+};
@@ -0,0 +1,857 @@
+#include "ReactorServer.h"
+
+#include "Endpoint.h"
+
+// Core
+#include <Poco/Ascii.h>
+#include <Poco/Exception.h>
+#include <Poco/NumberFormatter.h>
+#include <Poco/NumberParser.h>
+
+// DateTime
+#include <Poco/DateTimeFormat.h>
+#include <Poco/DateTimeFormatter.h>
+#include <Poco/Timestamp.h>
+
+// Sockets
+#include <Poco/Net/SocketAddress.h>
+
+// Threading
+#include <Poco/Runnable.h>
+#include <Poco/Thread.h>
+
+#if defined(__linux__)
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace
+{
+    // Requests whose headers don't fit are answered with 431 and closed.
+    const std::size_t MAX_HEADER_SIZE = 8 * 1024;
+    const std::size_t READ_SIZE = 16 * 1024;
+    const int MAX_EVENTS = 256;
+
+    // Pipelined responses are sent once they pass this many pieces, and
+    // sendmsg() takes at most MAX_IOVECS of them at a time, under IOV_MAX.
+    const std::size_t MAX_BATCH_PARTS = 256;
+    const std::size_t MAX_IOVECS = 1024;
+
+    typedef std::chrono::steady_clock Clock;
+
+    Poco::IOException SocketError(const std::string &what)
+    {
+        return Poco::IOException(what, std::strerror(errno), errno);
+    }
+
+    bool EqualsIgnoreCase(const char *text, std::size_t length, const char *word)
+    {
+        std::size_t i = 0;
+        for (; i < length && word[i]; ++i)
+        {
+            if (Poco::Ascii::toLower(text[i]) != Poco::Ascii::toLower(word[i]))
+            {
+                return false;
+            }
+        }
+        return i == length && !word[i];
+    }
+
+    void TrimSpace(const char *&begin, const char *&end)
+    {
+        while (begin < end && (*begin == ' ' || *begin == '\t'))
+        {
+            ++begin;
+        }
+        while (end > begin && (end[-1] == ' ' || end[-1] == '\t'))
+        {
+            --end;
+        }
+    }
+}
+
+class ReactorServer::Loop : public Poco::Runnable
+{
+public:
+    Loop(const Router &router, const ServerSettings &settings, Metrics &metrics, Rcu &rcu)
+        : router_(router),
+          settings_(settings),
+          metrics_(metrics),
+          rcu_(rcu),
+          listenFd_(-1),
+          epollFd_(-1),
+          wakeFd_(-1),
+          spareFd_(-1),
+          listening_(true),
+          stop_(false),
+          connectionCount_(0),
+          accepted_(0),
+          dateSecond_(0)
+    {
+    }
+
+    ~Loop()
+    {
+        for (auto &entry : connections_)
+        {
+            ::close(entry.first);
+        }
+        for (int fd : {listenFd_, epollFd_, wakeFd_, spareFd_})
+        {
+            if (fd >= 0)
+            {
+                ::close(fd);
+            }
+        }
+    }
+
+    void bind()
+    {
+        listenFd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listenFd_ < 0)
+        {
+            throw SocketError("socket");
+        }
+
+        const int on = 1;
+        ::setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if (::setsockopt(listenFd_, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) != 0)
+        {
+            throw SocketError("SO_REUSEPORT");
+        }
+
+        sockaddr_in address;
+        std::memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        address.sin_port = htons(settings_.port);
+        if (::bind(listenFd_, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0)
+        {
+            throw SocketError("bind to port " + Poco::NumberFormatter::format(settings_.port));
+        }
+        if (::listen(listenFd_, settings_.backlog) != 0)
+        {
+            throw SocketError("listen");
+        }
+
+        epollFd_ = ::epoll_create1(EPOLL_CLOEXEC);
+        wakeFd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epollFd_ < 0 || wakeFd_ < 0)
+        {
+            throw SocketError("epoll");
+        }
+        watch(listenFd_, EPOLLIN, EPOLL_CTL_ADD);
+        watch(wakeFd_, EPOLLIN, EPOLL_CTL_ADD);
+        spareFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+    }
+
+    void start()
+    {
+        thread_.start(*this);
+    }
+
+    void stop()
+    {
+        stop_ = true;
+        const Poco::UInt64 one = 1;
+        if (::write(wakeFd_, &one, sizeof(one)) < 0)
+        {
+            // The counter can't overflow from a single write; nothing to do.
+        }
+        thread_.join();
+    }
+
+    // Written by the loop alone, read by scrapes from any loop.
+    std::size_t connections() const { return connectionCount_.load(std::memory_order_relaxed); }
+    Poco::UInt64 accepted() const { return accepted_.load(std::memory_order_relaxed); }
+
+    void run() override
+    {
+        epoll_event events[MAX_EVENTS];
+        Clock::time_point lastSweep = Clock::now();
+        while (!stop_)
+        {
+            const int count = ::epoll_wait(epollFd_, events, MAX_EVENTS, 1000);
+            for (int i = 0; i < count; ++i)
+            {
+                const int fd = events[i].data.fd;
+                if (fd == listenFd_)
+                {
+                    accept();
+                }
+                else if (fd != wakeFd_)
+                {
+                    serve(fd, events[i].events);
+                }
+            }
+
+            const Clock::time_point now = Clock::now();
+            if (now - lastSweep >= std::chrono::seconds(1))
+            {
+                sweep(now);
+                lastSweep = now;
+                if (!listening_)
+                {
+                    resume();
+                }
+            }
+        }
+    }
+
+private:
+    struct Connection
+    {
+        std::string address;
+        std::string in;
+        std::size_t scanned = 0; // bytes of `in` known not to end the headers
+        Poco::UInt64 discard = 0; // body bytes still to come and be dropped
+        std::string out; // unsent response bytes
+        unsigned requests = 0;
+        bool closing = false;
+        bool writing = false; // waiting for EPOLLOUT
+        Clock::time_point active;
+    };
+
+    struct Part
+    {
+        const char *data; // null for a range of scratch_
+        std::size_t offset;
+        std::size_t length;
+    };
+
+    // What the headers of one request said, as far as serving it goes.
+    struct Request
+    {
+        bool head = false;
+        bool keepAlive = true;
+        bool http10 = false;
+    };
+
+    void watch(int fd, Poco::UInt32 events, int operation)
+    {
+        epoll_event event;
+        std::memset(&event, 0, sizeof(event));
+        event.events = events;
+        event.data.fd = fd;
+        ::epoll_ctl(epollFd_, operation, fd, &event);
+    }
+
+    void accept()
+    {
+        for (;;)
+        {
+            sockaddr_storage address;
+            socklen_t length = sizeof(address);
+            const int fd = ::accept4(listenFd_, reinterpret_cast<sockaddr *>(&address), &length, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0)
+            {
+                // Out of descriptors, the listener would stay readable and
+                // the loop spin, so the connection is shed instead.
+                if ((errno == EMFILE || errno == ENFILE) && shed())
+                {
+                    continue;
+                }
+                // EAGAIN once the backlog is empty.
+                return;
+            }
+
+            const int on = 1;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+            Connection &connection = connections_[fd];
+            connection.address = Poco::Net::SocketAddress(reinterpret_cast<const sockaddr *>(&address), length).toString();
+            connection.active = Clock::now();
+            watch(fd, EPOLLIN | EPOLLRDHUP, EPOLL_CTL_ADD);
+            connectionCount_.store(connections_.size(), std::memory_order_relaxed);
+            accepted_.store(accepted_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+    }
+
+    // Accepts the next connection through the spare descriptor and closes
+    // it. Without a spare, stops listening until the next sweep. Returns true
+    // if a connection was shed.
+    bool shed()
+    {
+        if (spareFd_ >= 0)
+        {
+            ::close(spareFd_);
+            const int fd = ::accept4(listenFd_, nullptr, nullptr, SOCK_CLOEXEC);
+            const int error = errno;
+            if (fd >= 0)
+            {
+                ::close(fd);
+            }
+            spareFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+            if (fd >= 0 || error == EAGAIN)
+            {
+                return fd >= 0;
+            }
+        }
+
+        listening_ = false;
+        watch(listenFd_, 0, EPOLL_CTL_MOD);
+        return false;
+    }
+
+    void resume()
+    {
+        if (spareFd_ < 0)
+        {
+            spareFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+        }
+        listening_ = true;
+        watch(listenFd_, EPOLLIN, EPOLL_CTL_MOD);
+    }
+
+    void serve(int fd, Poco::UInt32 events)
+    {
+        auto it = connections_.find(fd);
+        if (it == connections_.end())
+        {
+            return;
+        }
+        Connection &connection = it->second;
+        connection.active = Clock::now();
+
+        if (events & EPOLLERR)
+        {
+            close(fd);
+            return;
+        }
+
+        if ((events & EPOLLOUT) && !flush(fd, connection))
+        {
+            return;
+        }
+
+        // Nothing is read while a response waits to go out, so a client
+        // that pipelines without reading can't grow the input buffer.
+        bool eof = false;
+        if (!connection.writing && (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)))
+        {
+            char buffer[READ_SIZE];
+            const ssize_t n = ::recv(fd, buffer, sizeof(buffer), 0);
+            if (n < 0 && errno != EAGAIN && errno != EINTR)
+            {
+                close(fd);
+                return;
+            }
+            if (n > 0)
+            {
+                connection.in.append(buffer, static_cast<std::size_t>(n));
+            }
+            eof = n == 0;
+        }
+
+        process(fd, connection, eof);
+    }
+
+    // Answers every complete request in the input buffer, pipelined ones
+    // included, and sends the responses together, MAX_BATCH_PARTS pieces or
+    // so at a time. Stops early if the socket can't take them all.
+    // After `eof`, the connection closes once they're sent.
+    void process(int fd, Connection &connection, bool eof)
+    {
+        const Rcu::ReadGuard guard(rcu_);
+        std::size_t consumed = 0;
+        while (!connection.closing && connection.out.empty())
+        {
+            // Bodies are dropped as they arrive rather than buffered.
+            if (connection.discard > 0)
+            {
+                const std::size_t dropped = static_cast<std::size_t>(std::min<Poco::UInt64>(connection.discard, connection.in.size() - consumed));
+                consumed += dropped;
+                connection.discard -= dropped;
+                if (connection.discard > 0)
+                {
+                    break;
+                }
+            }
+
+            const std::size_t from = consumed + std::max<std::size_t>(connection.scanned, 3) - 3;
+            const std::size_t end = connection.in.find("\r\n\r\n", from);
+            if (end == std::string::npos)
+            {
+                connection.scanned = connection.in.size() - consumed;
+                if (connection.scanned > MAX_HEADER_SIZE)
+                {
+                    respondError(connection, 431, Request(), true);
+                }
+                break;
+            }
+
+            const std::size_t headerEnd = end + 4;
+            if (headerEnd - consumed > MAX_HEADER_SIZE)
+            {
+                respondError(connection, 431, Request(), true);
+                break;
+            }
+
+            handle(connection, connection.in.data() + consumed, connection.in.data() + end);
+            consumed = headerEnd;
+            connection.scanned = 0;
+
+            if (parts_.size() >= MAX_BATCH_PARTS)
+            {
+                send(fd, connection);
+            }
+        }
+        send(fd, connection);
+
+        if (consumed > 0)
+        {
+            connection.in.erase(0, consumed);
+        }
+        if ((connection.closing || eof) && connection.out.empty())
+        {
+            close(fd);
+        }
+        else if (eof)
+        {
+            // Only wait to write; the read side would report EOF forever.
+            connection.closing = true;
+            connection.writing = true;
+            watch(fd, EPOLLOUT, EPOLL_CTL_MOD);
+        }
+    }
+
+    // Parses one request's headers, [begin, end), and queues the response.
+    // Nothing here takes a body; its length goes to `discard`, to be dropped
+    // as it arrives.
+    void handle(Connection &connection, const char *begin, const char *end)
+    {
+        Request request;
+
+        const char *lineEnd = static_cast<const char *>(std::memchr(begin, '\r', end - begin));
+        if (!lineEnd)
+        {
+            lineEnd = end;
+        }
+        const char *methodEnd = static_cast<const char *>(std::memchr(begin, ' ', lineEnd - begin));
+        const char *targetEnd = methodEnd ? static_cast<const char *>(std::memchr(methodEnd + 1, ' ', lineEnd - methodEnd - 1)) : nullptr;
+        if (!targetEnd || lineEnd - targetEnd < 9 || std::memcmp(targetEnd + 1, "HTTP/1.", 7) != 0)
+        {
+            respondError(connection, 400, request, true);
+            return;
+        }
+        request.http10 = targetEnd[8] == '0';
+        request.keepAlive = !request.http10;
+
+        bool chunked = false;
+        const char *accept = nullptr;
+        std::size_t acceptLength = 0;
+        for (const char *line = lineEnd + 2; line < end;)
+        {
+            const char *next = static_cast<const char *>(std::memchr(line, '\r', end - line));
+            if (!next)
+            {
+                next = end;
+            }
+            const char *colon = static_cast<const char *>(std::memchr(line, ':', next - line));
+            if (colon)
+            {
+                const char *value = colon + 1;
+                const char *valueEnd = next;
+                TrimSpace(value, valueEnd);
+                if (EqualsIgnoreCase(line, colon - line, "connection"))
+                {
+                    if (EqualsIgnoreCase(value, valueEnd - value, "close"))
+                    {
+                        request.keepAlive = false;
+                    }
+                    else if (EqualsIgnoreCase(value, valueEnd - value, "keep-alive"))
+                    {
+                        request.keepAlive = true;
+                    }
+                }
+                else if (EqualsIgnoreCase(line, colon - line, "content-length"))
+                {
+                    Poco::UInt64 length = 0;
+                    if (!Poco::NumberParser::tryParseUnsigned64(std::string(value, valueEnd), length))
+                    {
+                        respondError(connection, 400, request, true);
+                        return;
+                    }
+                    connection.discard = length;
+                }
+                else if (EqualsIgnoreCase(line, colon - line, "accept"))
+                {
+                    accept = value;
+                    acceptLength = valueEnd - value;
+                }
+                else if (EqualsIgnoreCase(line, colon - line, "transfer-encoding"))
+                {
+                    chunked = true;
+                }
+            }
+            line = next + 2;
+        }
+
+        if (chunked)
+        {
+            respondError(connection, 501, request, true);
+            return;
+        }
+
+        ++connection.requests;
+        const int maxRequests = settings_.params->getMaxKeepAliveRequests();
+        if (!settings_.params->getKeepAlive() || (maxRequests > 0 && connection.requests >= static_cast<unsigned>(maxRequests)))
+        {
+            request.keepAlive = false;
+        }
+
+        const Metrics::Timer timer;
+        const Router::Method method = Router::parseMethod(begin, methodEnd - begin);
+        request.head = method == Router::HEAD;
+        Router::Match match;
+        router_.match(method, methodEnd + 1, targetEnd - methodEnd - 1, match);
+        const Endpoint::Request endpointRequest = {method, match, connection.address, accept, acceptLength};
+        Endpoint::dispatch(endpointRequest, reply_);
+        respond(connection, request, !request.keepAlive);
+        metrics_.record(reply_.status(), timer.elapsed());
+    }
+
+    // For requests that never reach the router.
+    void respondError(Connection &connection, int status, const Request &request, bool close)
+    {
+        reply_.error(status);
+        respond(connection, request, close);
+        metrics_.record(status);
+    }
+
+    // Queues reply_. Its pieces are referenced where they outlive the batch,
+    // and copied to scratch_ where they're the reply's own.
+    void respond(Connection &connection, const Request &request, bool close)
+    {
+        Request closing = request;
+        closing.keepAlive = !close;
+        writeHeader(closing);
+        if (!request.head)
+        {
+            for (std::size_t i = 0; i < reply_.pieces(); ++i)
+            {
+                if (reply_.owned(i))
+                {
+                    const std::size_t offset = scratch_.size();
+                    scratch_.append(reply_.data(i), reply_.length(i));
+                    addScratch(offset);
+                }
+                else
+                {
+                    add(reply_.data(i), reply_.length(i));
+                }
+            }
+        }
+        connection.closing = close;
+    }
+
+    void writeHeader(const Request &request)
+    {
+        const std::size_t offset = scratch_.size();
+        scratch_.append(request.http10 ? "HTTP/1.0 " : "HTTP/1.1 ");
+        Poco::NumberFormatter::append(scratch_, reply_.status());
+        scratch_.append(" ");
+        scratch_.append(reply_.reason());
+        scratch_.append("\r\nDate: ");
+        scratch_.append(date());
+        scratch_.append("\r\nContent-Type: ");
+        scratch_.append(reply_.contentType());
+        scratch_.append("\r\nContent-Length: ");
+        Poco::NumberFormatter::append(scratch_, static_cast<Poco::UInt64>(reply_.contentLength()));
+        scratch_.append(request.keepAlive ? "\r\nConnection: Keep-Alive\r\n" : "\r\nConnection: close\r\n");
+        if (reply_.allow())
+        {
+            scratch_.append("Allow: ");
+            scratch_.append(reply_.allow());
+            scratch_.append("\r\n");
+        }
+        if (reply_.vary())
+        {
+            scratch_.append("Vary: ");
+            scratch_.append(reply_.vary());
+            scratch_.append("\r\n");
+        }
+        scratch_.append("\r\n");
+        addScratch(offset);
+    }
+
+    // Memory that stays put until the batch is sent: the pages, the store and
+    // the connection's address.
+    void add(const char *data, std::size_t length)
+    {
+        Part part = {data, 0, length};
+        parts_.push_back(part);
+    }
+
+    // scratch_ from `offset` to its end. Recorded as an offset, since
+    // scratch_ may move as the batch grows.
+    void addScratch(std::size_t offset)
+    {
+        Part part = {nullptr, offset, scratch_.size() - offset};
+        parts_.push_back(part);
+    }
+
+    // Writes the batch, keeping what the socket won't take for EPOLLOUT.
+    void send(int fd, Connection &connection)
+    {
+        if (parts_.empty())
+        {
+            return;
+        }
+
+        iovecs_.resize(parts_.size());
+        for (std::size_t i = 0; i < parts_.size(); ++i)
+        {
+            const char *data = parts_[i].data ? parts_[i].data : scratch_.data() + parts_[i].offset;
+            iovecs_[i].iov_base = const_cast<char *>(data);
+            iovecs_[i].iov_len = parts_[i].length;
+        }
+        parts_.clear();
+
+        std::size_t skip = 0;
+        for (std::size_t first = 0; first < iovecs_.size(); first += MAX_IOVECS)
+        {
+            // sendmsg() rather than writev(), for MSG_NOSIGNAL: a client that
+            // has gone must not raise SIGPIPE.
+            msghdr message;
+            std::memset(&message, 0, sizeof(message));
+            message.msg_iov = &iovecs_[first];
+            message.msg_iovlen = std::min(MAX_IOVECS, iovecs_.size() - first);
+            const std::size_t count = message.msg_iovlen;
+            ssize_t written;
+            do
+            {
+                written = ::sendmsg(fd, &message, MSG_NOSIGNAL);
+            } while (written < 0 && errno == EINTR);
+            if (written < 0 && errno != EAGAIN)
+            {
+                scratch_.clear();
+                connection.closing = true;
+                connection.out.clear();
+                return;
+            }
+
+            std::size_t length = 0;
+            for (std::size_t i = first; i < first + count; ++i)
+            {
+                length += iovecs_[i].iov_len;
+            }
+            skip += written > 0 ? static_cast<std::size_t>(written) : 0;
+            if (written < 0 || static_cast<std::size_t>(written) < length)
+            {
+                break; // the socket is full
+            }
+        }
+
+        for (const iovec &part : iovecs_)
+        {
+            if (skip >= part.iov_len)
+            {
+                skip -= part.iov_len;
+                continue;
+            }
+            connection.out.append(static_cast<const char *>(part.iov_base) + skip, part.iov_len - skip);
+            skip = 0;
+        }
+        scratch_.clear();
+        if (!connection.out.empty() && !connection.writing)
+        {
+            connection.writing = true;
+            watch(fd, EPOLLOUT, EPOLL_CTL_MOD);
+        }
+    }
+
+    // Sends buffered output. Returns false if the connection was closed.
+    bool flush(int fd, Connection &connection)
+    {
+        while (!connection.out.empty())
+        {
+            const ssize_t n = ::send(fd, connection.out.data(), connection.out.size(), MSG_NOSIGNAL);
+            if (n < 0)
+            {
+                if (errno == EAGAIN || errno == EINTR)
+                {
+                    return true;
+                }
+                close(fd);
+                return false;
+            }
+            connection.out.erase(0, static_cast<std::size_t>(n));
+        }
+
+        connection.writing = false;
+        watch(fd, EPOLLIN | EPOLLRDHUP, EPOLL_CTL_MOD);
+        if (connection.closing)
+        {
+            close(fd);
+            return false;
+        }
+        return true;
+    }
+
+    // Closes connections idle past the keep-alive timeout, or stuck in a
+    // request past the request timeout.
+    void sweep(Clock::time_point now)
+    {
+        const std::chrono::microseconds keepAlive(settings_.params->getKeepAliveTimeout().totalMicroseconds());
+        const std::chrono::microseconds timeout(settings_.params->getTimeout().totalMicroseconds());
+        for (auto it = connections_.begin(); it != connections_.end();)
+        {
+            const Connection &connection = it->second;
+            const bool idle = connection.in.empty() && connection.out.empty() && connection.discard == 0;
+            if (now - connection.active > (idle ? keepAlive : timeout))
+            {
+                ::close(it->first);
+                it = connections_.erase(it);
+                connectionCount_.store(connections_.size(), std::memory_order_relaxed);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    void close(int fd)
+    {
+        ::close(fd);
+        connections_.erase(fd);
+        connectionCount_.store(connections_.size(), std::memory_order_relaxed);
+    }
+
+    // The Date header, formatted once a second.
+    const std::string &date()
+    {
+        const Poco::Timestamp now;
+        const std::time_t second = now.epochTime();
+        if (second != dateSecond_)
+        {
+            date_ = Poco::DateTimeFormatter::format(now, Poco::DateTimeFormat::HTTP_FORMAT);
+            dateSecond_ = second;
+        }
+        return date_;
+    }
+
+    const Router &router_;
+    const ServerSettings &settings_;
+    Metrics &metrics_;
+    Rcu &rcu_;
+    int listenFd_;
+    int epollFd_;
+    int wakeFd_;
+    int spareFd_; // given up to accept and shed a connection when out of descriptors
+    bool listening_;
+    std::atomic<bool> stop_;
+    std::atomic<std::size_t> connectionCount_;
+    std::atomic<Poco::UInt64> accepted_;
+    Poco::Thread thread_;
+    std::unordered_map<int, Connection> connections_;
+    // Responses queued by process(), sent together.
+    Reply reply_;
+    std::string scratch_; // headers and copied reply pieces
+    std::vector<Part> parts_;
+    std::vector<iovec> iovecs_;
+    std::string date_;
+    std::time_t dateSecond_;
+};
+
+ReactorServer::ReactorServer(const Router &router, const ServerSettings &settings, Metrics &metrics, Rcu &rcu)
+    : router_(router), settings_(settings), metrics_(metrics), rcu_(rcu)
+{
+}
+
+ReactorServer::~ReactorServer()
+{
+    stop();
+}
+
+void ReactorServer::start()
+{
+    for (int i = 0; i < settings_.reactorThreads; ++i)
+    {
+        loops_.emplace_back(new Loop(router_, settings_, metrics_, rcu_));
+        loops_.back()->bind();
+    }
+    for (auto &loop : loops_)
+    {
+        loop->start();
+    }
+}
+
+void ReactorServer::stop()
+{
+    for (auto &loop : loops_)
+    {
+        loop->stop();
+    }
+    loops_.clear();
+}
+
+std::size_t ReactorServer::connections() const
+{
+    std::size_t total = 0;
+    for (const auto &loop : loops_)
+    {
+        total += loop->connections();
+    }
+    return total;
+}
+
+Poco::UInt64 ReactorServer::accepted() const
+{
+    Poco::UInt64 total = 0;
+    for (const auto &loop : loops_)
+    {
+        total += loop->accepted();
+    }
+    return total;
+}
+
+#else
+
+class ReactorServer::Loop
+{
+};
+
+ReactorServer::ReactorServer(const Router &router, const ServerSettings &settings, Metrics &metrics, Rcu &rcu)
+    : router_(router), settings_(settings), metrics_(metrics), rcu_(rcu)
+{
+}
+
+ReactorServer::~ReactorServer()
+{
+}
+
+void ReactorServer::start()
+{
+    throw Poco::NotImplementedException("the reactor engine needs epoll");
+}
+
+void ReactorServer::stop()
+{
+}
+
+std::size_t ReactorServer::connections() const
+{
+    return 0;
+}
+
+Poco::UInt64 ReactorServer::accepted() const
+{
+    return 0;
+}
+
+#endif
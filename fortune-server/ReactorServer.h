@@ -0,0 +1,57 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "Metrics.h"
+#include "Rcu.h"
+#include "Router.h"
+#include "ServerSettings.h"
+
+// Serves the routes from one epoll loop per thread, as an alternative to
+// Poco's HTTPServer and its thread per connection.
+//
+// Every loop listens on the same port through its own SO_REUSEPORT socket, so
+// the kernel spreads new connections over the loops without a shared accept
+// lock, and a connection stays on the loop that accepted it. Sockets are
+// non-blocking and requests are parsed as their bytes arrive, so a slow or
+// idle keep-alive client costs a buffer rather than a thread. Responses go
+// out with sendmsg() straight from the endpoint's pieces, such as the
+// pre-rendered pages.
+//
+// A connection's state is its handler; nothing is allocated per request.
+// Pipelined requests that arrive together are answered together: each one
+// adds its header and the page pieces to a batch, and the batch leaves in a
+// single sendmsg().
+//
+// Requests go through the same Router and endpoints as the HTTPServer engine,
+// and are recorded in the same Metrics. A read section of the Rcu spans each
+// batch, from routing until its pieces are sent or copied. Timeouts,
+// keep-alive and the backlog come from the same settings. Linux only.
+class ReactorServer
+{
+public:
+    ReactorServer(const Router &router, const ServerSettings &settings, Metrics &metrics, Rcu &rcu);
+    ~ReactorServer();
+
+    // Binds every loop's socket, then starts the loops. Throws
+    // Poco::IOException if a socket can't be set up.
+    void start();
+    void stop();
+
+    // Summed over the loops; safe to call while they run.
+    std::size_t connections() const;
+    Poco::UInt64 accepted() const;
+
+private:
+    ReactorServer(const ReactorServer &);
+    ReactorServer &operator=(const ReactorServer &);
+
+    class Loop;
+
+    const Router &router_;
+    const ServerSettings &settings_;
+    Metrics &metrics_;
+    Rcu &rcu_;
+    std::vector<std::unique_ptr<Loop>> loops_;
+};
@@ -0,0 +1,249 @@
+#include "Router.h"
+
+#include <algorithm>
+#include <cstring>
+
+// Core
+#include <Poco/Exception.h>
+
+struct Router::Route
+{
+    unsigned methods;
+    const Endpoint *endpoint;
+    std::string allow;
+};
+
+struct Router::Node
+{
+    struct Edge
+    {
+        std::string segment;
+        std::unique_ptr<Node> node;
+    };
+
+    std::vector<Edge> children; // sorted by segment
+    std::unique_ptr<Node> parameter; // {name}
+    const Route *route = nullptr; // the path ends here
+    const Route *prefix = nullptr; // the path continues below here
+
+    const Node *child(const char *segment, std::size_t length) const
+    {
+        auto it = std::lower_bound(children.begin(), children.end(), std::make_pair(segment, length), [](const Edge &edge, const std::pair<const char *, std::size_t> &key) {
+            return edge.segment.compare(0, std::string::npos, key.first, key.second) < 0;
+        });
+        if (it != children.end() && it->segment.compare(0, std::string::npos, segment, length) == 0)
+        {
+            return it->node.get();
+        }
+        return nullptr;
+    }
+
+    Node &add(const std::string &segment)
+    {
+        auto it = std::lower_bound(children.begin(), children.end(), segment, [](const Edge &edge, const std::string &key) {
+            return edge.segment < key;
+        });
+        if (it == children.end() || it->segment != segment)
+        {
+            Edge edge = {segment, std::unique_ptr<Node>(new Node)};
+            it = children.insert(it, std::move(edge));
+        }
+        return *it->node;
+    }
+};
+
+namespace
+{
+    const struct
+    {
+        Router::Method method;
+        const char *name;
+    } METHODS[] = {
+        {Router::GET, "GET"},
+        {Router::HEAD, "HEAD"},
+        {Router::POST, "POST"},
+        {Router::PUT, "PUT"},
+        {Router::DELETE, "DELETE"},
+        {Router::OPTIONS, "OPTIONS"},
+        {Router::PATCH, "PATCH"},
+    };
+
+    // The end of the segment starting at `segment`.
+    const char *SegmentEnd(const char *segment, const char *end)
+    {
+        const char *slash = static_cast<const char *>(std::memchr(segment, '/', end - segment));
+        return slash ? slash : end;
+    }
+}
+
+Router::Router() : root_(new Node)
+{
+}
+
+Router::~Router()
+{
+}
+
+void Router::add(unsigned methods, const std::string &pattern, const Endpoint &endpoint)
+{
+    if (pattern.empty() || pattern[0] != '/' || methods == 0)
+    {
+        throw Poco::InvalidArgumentException("bad route", pattern);
+    }
+
+    std::unique_ptr<Route> route(new Route);
+    route->methods = methods;
+    route->endpoint = &endpoint;
+    for (const auto &entry : METHODS)
+    {
+        if (methods & entry.method)
+        {
+            route->allow += route->allow.empty() ? "" : ", ";
+            route->allow += entry.name;
+        }
+    }
+
+    // "/" is the root itself; otherwise each segment after a '/' is a step.
+    Node *node = root_.get();
+    unsigned parameters = 0;
+    bool prefix = false;
+    for (std::size_t begin = 1; pattern.size() > 1 && begin <= pattern.size();)
+    {
+        std::size_t end = pattern.find('/', begin);
+        if (end == std::string::npos)
+        {
+            end = pattern.size();
+        }
+        const std::string segment = pattern.substr(begin, end - begin);
+        begin = end + 1;
+
+        if (segment == "*")
+        {
+            if (end != pattern.size())
+            {
+                throw Poco::InvalidArgumentException("'*' must end a route", pattern);
+            }
+            prefix = true;
+        }
+        else if (segment.size() > 2 && segment.front() == '{' && segment.back() == '}')
+        {
+            if (++parameters > MAX_PARAMETERS)
+            {
+                throw Poco::InvalidArgumentException("too many parameters in route", pattern);
+            }
+            if (!node->parameter)
+            {
+                node->parameter.reset(new Node);
+            }
+            node = node->parameter.get();
+        }
+        else
+        {
+            node = &node->add(segment);
+        }
+    }
+
+    const Route *&slot = prefix ? node->prefix : node->route;
+    if (slot)
+    {
+        throw Poco::InvalidArgumentException("route added twice", pattern);
+    }
+    slot = route.get();
+    routes_.push_back(std::move(route));
+}
+
+void Router::match(Method method, const char *target, std::size_t length, Match &match) const
+{
+    const char *end = target + length;
+    const char *question = static_cast<const char *>(std::memchr(target, '?', length));
+
+    match = Match();
+    match.path = target;
+    match.pathLength = (question ? question : end) - target;
+    if (question)
+    {
+        match.query = question + 1;
+        match.queryLength = end - match.query;
+    }
+
+    const Route *route = nullptr;
+    if (match.pathLength == 0 || *target != '/' || !find(*root_, target + 1, target + match.pathLength, match, route))
+    {
+        match.parameterCount = 0;
+        return;
+    }
+
+    match.allow = route->allow.c_str();
+    if (route->methods & method)
+    {
+        match.result = Match::FOUND;
+        match.endpoint = route->endpoint;
+    }
+    else
+    {
+        match.result = Match::METHOD_NOT_ALLOWED;
+    }
+}
+
+// Matches the rest of the path, from `segment`, below `node`. A fixed child is
+// tried before the parameter, and the parameter before a prefix route here.
+bool Router::find(const Node &node, const char *segment, const char *end, Match &match, const Route *&route) const
+{
+    if (segment > end)
+    {
+        if (node.route)
+        {
+            route = node.route;
+            return true;
+        }
+        return false;
+    }
+
+    // "/" alone ends at the root.
+    if (&node == root_.get() && segment == end && node.route)
+    {
+        route = node.route;
+        return true;
+    }
+
+    const char *segmentEnd = SegmentEnd(segment, end);
+    const std::size_t segmentLength = segmentEnd - segment;
+
+    const Node *child = node.child(segment, segmentLength);
+    if (child && find(*child, segmentEnd + 1, end, match, route))
+    {
+        return true;
+    }
+
+    if (node.parameter && segmentLength > 0)
+    {
+        const unsigned count = match.parameterCount;
+        match.parameters[count].data = segment;
+        match.parameters[count].length = segmentLength;
+        match.parameterCount = count + 1;
+        if (find(*node.parameter, segmentEnd + 1, end, match, route))
+        {
+            return true;
+        }
+        match.parameterCount = count;
+    }
+
+    if (node.prefix)
+    {
+        route = node.prefix;
+        return true;
+    }
+    return false;
+}
+
+Router::Method Router::parseMethod(const char *name, std::size_t length)
+{
+    for (const auto &entry : METHODS)
+    {
+        if (std::strlen(entry.name) == length && std::memcmp(entry.name, name, length) == 0)
+        {
+            return entry.method;
+        }
+    }
+    return OTHER;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+class Endpoint;
+
+// Maps a method and a request target to an Endpoint.
+//
+// Routes are added at startup into a trie of path segments, so a lookup walks
+// the target once, with a binary search among each segment's fixed children,
+// however many routes there are. Patterns are made of '/'-separated segments:
+//
+//   /fortune          exact
+//   /fortune/{id}     a parameter: any one non-empty segment, captured
+//   /static/*         a prefix: anything below /static/
+//
+// A fixed segment beats a parameter, and both beat a prefix. The query string
+// is left for the endpoint. Matching doesn't allocate.
+class Router
+{
+public:
+    enum Method
+    {
+        GET = 1 << 0,
+        HEAD = 1 << 1,
+        POST = 1 << 2,
+        PUT = 1 << 3,
+        DELETE = 1 << 4,
+        OPTIONS = 1 << 5,
+        PATCH = 1 << 6,
+        OTHER = 1 << 7
+    };
+
+    static const unsigned MAX_PARAMETERS = 4;
+
+    struct Match
+    {
+        enum Result
+        {
+            FOUND,
+            NOT_FOUND,
+            METHOD_NOT_ALLOWED
+        };
+
+        Result result = NOT_FOUND;
+        const Endpoint *endpoint = nullptr;
+        const char *allow = nullptr; // the route's methods, for 405s
+        const char *path = nullptr;
+        std::size_t pathLength = 0;
+        const char *query = nullptr; // after the '?', if any
+        std::size_t queryLength = 0;
+        struct
+        {
+            const char *data;
+            std::size_t length;
+        } parameters[MAX_PARAMETERS];
+        unsigned parameterCount = 0;
+    };
+
+    Router();
+    ~Router();
+
+    // `methods` is a mask of Method values. Throws Poco::InvalidArgumentException
+    // for a malformed pattern or one that's already routed.
+    void add(unsigned methods, const std::string &pattern, const Endpoint &endpoint);
+
+    // Fills in `match` for the request target (path and query). `target` must
+    // outlive the match, which points into it.
+    void match(Method method, const char *target, std::size_t length, Match &match) const;
+
+    static Method parseMethod(const char *name, std::size_t length);
+    static Method parseMethod(const std::string &name) { return parseMethod(name.data(), name.size()); }
+
+private:
+    Router(const Router &);
+    Router &operator=(const Router &);
+
+    struct Route;
+    struct Node;
+
+    bool find(const Node &node, const char *segment, const char *end, Match &match, const Route *&route) const;
+
+    std::unique_ptr<Node> root_;
+    std::vector<std::unique_ptr<Route>> routes_;
+};
@@ -0,0 +1,110 @@
+#include "ServerSettings.h"
+
+#include <algorithm>
+
+// Core
+#include <Poco/Environment.h>
+#include <Poco/Exception.h>
+#include <Poco/NumberFormatter.h>
+
+namespace
+{
+    Poco::Timespan Seconds(int seconds)
+    {
+        return Poco::Timespan(seconds, 0);
+    }
+}
+
+ServerSettings ServerSettings::fromConfig(const Poco::Util::AbstractConfiguration &config)
+{
+    ServerSettings settings;
+    settings.params = new Poco::Net::HTTPServerParams;
+    Poco::Net::HTTPServerParams &params = *settings.params;
+
+    int maxQueued = params.getMaxQueued();
+    int threadIdleTime = static_cast<int>(params.getThreadIdleTime().totalSeconds());
+    int timeout = static_cast<int>(params.getTimeout().totalSeconds());
+    int keepAliveTimeout = static_cast<int>(params.getKeepAliveTimeout().totalSeconds());
+
+    const std::string tuning = config.getString("FortuneServer.tuning", "default");
+    if (tuning == "auto")
+    {
+        // Requests are short and block only on the network, so far more
+        // threads than cores pay off; the queue absorbs bursts of new
+        // connections rather than refusing them.
+        const int cores = static_cast<int>(Poco::Environment::processorCount());
+        settings.backlog = 4096;
+        settings.minThreads = cores;
+        settings.maxThreads = std::min(cores * 32, 4096);
+        settings.stackSize = 256 * 1024;
+        maxQueued = 16384;
+        timeout = 10;
+        keepAliveTimeout = 2;
+    }
+    else if (tuning != "default")
+    {
+        throw Poco::InvalidArgumentException("FortuneServer.tuning must be default or auto", tuning);
+    }
+
+    settings.engine = config.getString("FortuneServer.engine", settings.engine);
+    if (settings.engine != "threads" && settings.engine != "reactor")
+    {
+        throw Poco::InvalidArgumentException("FortuneServer.engine must be threads or reactor", settings.engine);
+    }
+    settings.reactorThreads = std::max(1, config.getInt("FortuneServer.reactor.threads", static_cast<int>(Poco::Environment::processorCount())));
+
+    settings.port = static_cast<Poco::UInt16>(config.getUInt("FortuneServer.port", settings.port));
+    settings.backlog = config.getInt("FortuneServer.backlog", settings.backlog);
+    settings.maxThreads = std::max(1, config.getInt("FortuneServer.threads.max", settings.maxThreads));
+    settings.minThreads = std::min(settings.maxThreads, config.getInt("FortuneServer.threads.min", settings.minThreads));
+    settings.threadIdleTime = config.getInt("FortuneServer.threads.idleTime", settings.threadIdleTime);
+    settings.stackSize = config.getInt("FortuneServer.threads.stackSize", settings.stackSize);
+
+    params.setMaxThreads(settings.maxThreads);
+    params.setMaxQueued(config.getInt("FortuneServer.maxQueued", maxQueued));
+    params.setThreadIdleTime(Seconds(config.getInt("FortuneServer.threadIdleTime", threadIdleTime)));
+    params.setTimeout(Seconds(config.getInt("FortuneServer.timeout", timeout)));
+    params.setKeepAlive(config.getBool("FortuneServer.keepAlive", params.getKeepAlive()));
+    params.setKeepAliveTimeout(Seconds(config.getInt("FortuneServer.keepAliveTimeout", keepAliveTimeout)));
+    params.setMaxKeepAliveRequests(config.getInt("FortuneServer.maxKeepAliveRequests", params.getMaxKeepAliveRequests()));
+    if (config.has("FortuneServer.serverName"))
+    {
+        params.setServerName(config.getString("FortuneServer.serverName"));
+    }
+
+    return settings;
+}
+
+std::string ServerSettings::describe() const
+{
+    std::string text(engine);
+    text += " engine, port ";
+    Poco::NumberFormatter::append(text, port);
+    text += ", backlog ";
+    Poco::NumberFormatter::append(text, backlog);
+    if (engine == "reactor")
+    {
+        text += ", loops ";
+        Poco::NumberFormatter::append(text, reactorThreads);
+    }
+    else
+    {
+        text += ", threads ";
+        Poco::NumberFormatter::append(text, minThreads);
+        text += "..";
+        Poco::NumberFormatter::append(text, maxThreads);
+        text += ", queue ";
+        Poco::NumberFormatter::append(text, params->getMaxQueued());
+    }
+    text += ", keep-alive ";
+    if (params->getKeepAlive())
+    {
+        Poco::NumberFormatter::append(text, static_cast<int>(params->getKeepAliveTimeout().totalSeconds()));
+        text += " s";
+    }
+    else
+    {
+        text += "off";
+    }
+    return text;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+
+// Configuration
+#include <Poco/Util/AbstractConfiguration.h>
+
+// HTTPServer
+#include <Poco/Net/HTTPServerParams.h>
+
+// How the server listens and how many threads serve it, read from the
+// FortuneServer.* configuration:
+//
+//   engine                 "threads" (Poco's HTTPServer, a thread per
+//                          connection) or "reactor" (epoll loops, see
+//                          ReactorServer)
+//   tuning                 "default" (Poco's defaults) or "auto" (sized from
+//                          the core count for many keep-alive clients)
+//   reactor.threads        event loops for the reactor engine
+//   backlog                listen() backlog
+//   threads.min, .max      connection thread pool capacity
+//   threads.idleTime       seconds before a spare pool thread exits
+//   threads.stackSize      bytes, 0 for the platform default
+//   maxQueued              accepted connections waiting for a thread
+//   threadIdleTime         seconds before the server gives back an idle thread
+//   timeout                seconds a connection may stay silent mid-request
+//   keepAlive              whether connections are kept open
+//   keepAliveTimeout       seconds an idle kept-alive connection holds a thread
+//   maxKeepAliveRequests   requests per connection, 0 for no limit
+//
+// Every key overrides what the tuning picked. The server holds a thread per
+// open connection, so with "auto" idle keep-alive connections time out quickly
+// to hand their thread to the next one in the queue.
+struct ServerSettings
+{
+    std::string engine = "threads";
+    Poco::UInt16 port = 9999;
+    int backlog = 64;
+    int minThreads = 2;
+    int maxThreads = 16;
+    int threadIdleTime = 60;
+    int stackSize = 0;
+    int reactorThreads = 1;
+    Poco::Net::HTTPServerParams::Ptr params;
+
+    static ServerSettings fromConfig(const Poco::Util::AbstractConfiguration &config);
+
+    // One line for the startup log.
+    std::string describe() const;
+};
@@ -0,0 +1,560 @@
+// Application
+#include <Poco/Util/Application.h>
+
+// Core
+#include <Poco/Exception.h>
+#include <Poco/NumberParser.h>
+#include <Poco/SharedPtr.h>
+#include <Poco/Timespan.h>
+#include <Poco/Types.h>
+
+// Options
+#include <Poco/Util/HelpFormatter.h>
+#include <Poco/Util/IntValidator.h>
+#include <Poco/Util/Option.h>
+#include <Poco/Util/OptionSet.h>
+
+// Sockets
+#include <Poco/Net/SocketAddress.h>
+#include <Poco/Net/StreamSocket.h>
+
+// Threading
+#include <Poco/Runnable.h>
+#include <Poco/ThreadPool.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    Poco::UInt64 Nanoseconds(Clock::duration duration)
+    {
+        return static_cast<Poco::UInt64>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+    }
+
+    bool StartsWithIgnoreCase(const char *text, std::size_t length, const char *prefix)
+    {
+        std::size_t i = 0;
+        for (; prefix[i]; ++i)
+        {
+            if (i >= length || std::tolower(static_cast<unsigned char>(text[i])) != prefix[i])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+// Latencies in log-linear buckets, 16 to each power of two of nanoseconds, so
+// any percentile read back is within about 6%. Each connection keeps its own;
+// they're merged once the run is over.
+class LatencyHistogram
+{
+public:
+    LatencyHistogram() : buckets_(BUCKETS, 0), count_(0), total_(0), min_(~0ULL), max_(0)
+    {
+    }
+
+    void record(Poco::UInt64 nanoseconds)
+    {
+        ++buckets_[bucketOf(nanoseconds)];
+        ++count_;
+        total_ += nanoseconds;
+        min_ = std::min(min_, nanoseconds);
+        max_ = std::max(max_, nanoseconds);
+    }
+
+    void merge(const LatencyHistogram &other)
+    {
+        for (unsigned i = 0; i < BUCKETS; ++i)
+        {
+            buckets_[i] += other.buckets_[i];
+        }
+        count_ += other.count_;
+        total_ += other.total_;
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+    }
+
+    Poco::UInt64 count() const { return count_; }
+    Poco::UInt64 min() const { return count_ ? min_ : 0; }
+    Poco::UInt64 max() const { return max_; }
+    double mean() const { return count_ ? static_cast<double>(total_) / count_ : 0; }
+
+    // The latency below which a fraction q of requests fell, in nanoseconds:
+    // the top of its bucket, but never more than the largest seen.
+    Poco::UInt64 percentile(double q) const
+    {
+        if (count_ == 0)
+        {
+            return 0;
+        }
+        const Poco::UInt64 rank = std::max<Poco::UInt64>(1, static_cast<Poco::UInt64>(std::ceil(q * count_)));
+        Poco::UInt64 seen = 0;
+        for (unsigned i = 0; i < BUCKETS; ++i)
+        {
+            seen += buckets_[i];
+            if (seen >= rank)
+            {
+                return std::min(bucketLimit(i), max_);
+            }
+        }
+        return max_;
+    }
+
+private:
+    static const unsigned SUB_BUCKETS = 16;
+    static const unsigned BUCKETS = 61 * SUB_BUCKETS;
+
+    static unsigned bucketOf(Poco::UInt64 value)
+    {
+        if (value < SUB_BUCKETS)
+        {
+            return static_cast<unsigned>(value);
+        }
+        unsigned bit = 63;
+        while (!(value >> bit))
+        {
+            --bit;
+        }
+        const unsigned sub = static_cast<unsigned>(value >> (bit - 4)) & (SUB_BUCKETS - 1);
+        return std::min(BUCKETS - 1, (bit - 3) * SUB_BUCKETS + sub);
+    }
+
+    // The largest value in `bucket`.
+    static Poco::UInt64 bucketLimit(unsigned bucket)
+    {
+        const unsigned next = bucket + 1;
+        if (next < SUB_BUCKETS)
+        {
+            return bucket;
+        }
+        const unsigned bit = next / SUB_BUCKETS + 3;
+        return (static_cast<Poco::UInt64>(SUB_BUCKETS + next % SUB_BUCKETS) << (bit - 4)) - 1;
+    }
+
+    std::vector<Poco::UInt64> buckets_;
+    Poco::UInt64 count_;
+    Poco::UInt64 total_;
+    Poco::UInt64 min_;
+    Poco::UInt64 max_;
+};
+
+// Loads fortune-server, or any HTTP/1.1 server, from keep-alive connections
+// and reports throughput and the latency distribution, like wrk and wrk2.
+//
+// Closed loop, the default: every connection keeps --pipeline requests in
+// flight and sends another as each response arrives, so the offered load
+// follows the server. Open loop, with --rate: requests are due at a fixed rate
+// spread evenly over the connections, and each latency is measured from when
+// the request was due rather than when it went out. A server that stalls then
+// shows the queue it built up, instead of the client quietly waiting with it
+// and under-reporting the stall (coordinated omission).
+//
+// Each connection has a thread and a blocking socket of its own, which is
+// plenty for the few hundred connections a loopback test needs.
+class Bench : public Poco::Util::Application
+{
+private:
+    void defineOptions(Poco::Util::OptionSet &options) override
+    {
+        Poco::Util::Application::defineOptions(options);
+
+        options.addOption(
+            Poco::Util::Option("host", "", "server address (default 127.0.0.1)")
+                .argument("HOST"));
+        options.addOption(
+            Poco::Util::Option("port", "p", "server port (default 9999)")
+                .argument("PORT")
+                .validator(new Poco::Util::IntValidator(1, 65535)));
+        options.addOption(
+            Poco::Util::Option("path", "", "request target (default /)")
+                .argument("PATH"));
+        options.addOption(
+            Poco::Util::Option("accept", "", "send this Accept header")
+                .argument("TYPE"));
+        options.addOption(
+            Poco::Util::Option("connections", "c", "open N connections (default 16)")
+                .argument("N")
+                .validator(new Poco::Util::IntValidator(1, 4096)));
+        options.addOption(
+            Poco::Util::Option("pipeline", "", "keep up to N requests in flight on each connection (default 1)")
+                .argument("N")
+                .validator(new Poco::Util::IntValidator(1, 1024)));
+        options.addOption(
+            Poco::Util::Option("rate", "r", "send N requests a second in all, open loop (default: closed loop)")
+                .argument("N")
+                .validator(new Poco::Util::IntValidator(1, 100000000)));
+        options.addOption(
+            Poco::Util::Option("duration", "d", "run for N seconds (default 10)")
+                .argument("N")
+                .validator(new Poco::Util::IntValidator(1, 86400)));
+        options.addOption(
+            Poco::Util::Option("warmup", "", "run N seconds before measuring (default 1)")
+                .argument("N")
+                .validator(new Poco::Util::IntValidator(0, 3600)));
+        options.addOption(Poco::Util::Option("help", "", "display this help and exit."));
+    }
+
+    void handleOption(const std::string &name, const std::string &value) override
+    {
+        Poco::Util::Application::handleOption(name, value);
+
+        if (name == "host")
+        {
+            arg_host = value;
+        }
+        else if (name == "port")
+        {
+            arg_port = static_cast<Poco::UInt16>(Poco::NumberParser::parseUnsigned(value));
+        }
+        else if (name == "path")
+        {
+            arg_path = value;
+        }
+        else if (name == "accept")
+        {
+            arg_accept = value;
+        }
+        else if (name == "connections")
+        {
+            arg_connections = Poco::NumberParser::parseUnsigned(value);
+        }
+        else if (name == "pipeline")
+        {
+            arg_pipeline = Poco::NumberParser::parseUnsigned(value);
+        }
+        else if (name == "rate")
+        {
+            arg_rate = Poco::NumberParser::parseUnsigned(value);
+        }
+        else if (name == "duration")
+        {
+            arg_duration = Poco::NumberParser::parseUnsigned(value);
+        }
+        else if (name == "warmup")
+        {
+            arg_warmup = Poco::NumberParser::parseUnsigned(value);
+        }
+        else if (name == "help")
+        {
+            arg_help = true;
+        }
+    }
+
+    int main(const std::vector<std::string> &arguments) override;
+
+    // One keep-alive connection and its share of the load.
+    class Connection : public Poco::Runnable
+    {
+    public:
+        Connection(const Bench &bench, Clock::duration offset)
+            : bench_(bench), offset_(offset), requests_(0), bytes_(0), failed_(0), errors_(0), reconnects_(0)
+        {
+        }
+
+        void run() override;
+
+        const LatencyHistogram &latencies() const { return latencies_; }
+        Poco::UInt64 requests() const { return requests_; }
+        Poco::UInt64 bytes() const { return bytes_; }
+        Poco::UInt64 failed() const { return failed_; } // non-2xx
+        Poco::UInt64 errors() const { return errors_; } // lost to socket errors
+        Poco::UInt64 reconnects() const { return reconnects_; }
+
+    private:
+        // Takes complete responses off the front of in_. Returns false if the
+        // server asked to close the connection.
+        bool parse(Clock::time_point now);
+        void connect();
+
+        const Bench &bench_;
+        const Clock::duration offset_; // staggers open-loop schedules
+        Poco::Net::StreamSocket socket_;
+        std::string in_;
+        std::deque<Clock::time_point> due_; // requests in flight, oldest first
+        LatencyHistogram latencies_;
+        Poco::UInt64 requests_;
+        Poco::UInt64 bytes_;
+        Poco::UInt64 failed_;
+        Poco::UInt64 errors_;
+        Poco::UInt64 reconnects_;
+    };
+
+    void report(const std::vector<Poco::SharedPtr<Connection>> &connections, double seconds) const;
+
+    std::string arg_host = "127.0.0.1";
+    Poco::UInt16 arg_port = 9999;
+    std::string arg_path = "/";
+    std::string arg_accept;
+    unsigned arg_connections = 16;
+    unsigned arg_pipeline = 1;
+    unsigned arg_rate = 0;
+    unsigned arg_duration = 10;
+    unsigned arg_warmup = 1;
+    bool arg_help = false;
+
+    std::string request_;
+    Poco::Net::SocketAddress address_;
+    Clock::time_point start_; // measuring starts
+    Clock::time_point end_;
+};
+
+void Bench::Connection::connect()
+{
+    socket_ = Poco::Net::StreamSocket();
+    socket_.connect(bench_.address_);
+    socket_.setNoDelay(true);
+    in_.clear();
+}
+
+void Bench::Connection::run()
+{
+    const bool open = bench_.arg_rate > 0;
+    const Clock::duration interval = open ? std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds(1000000000ULL * bench_.arg_connections / bench_.arg_rate)) : Clock::duration::zero();
+    const Clock::time_point warmupStart = bench_.start_ - std::chrono::seconds(bench_.arg_warmup);
+    Clock::time_point next = warmupStart + offset_;
+
+    std::string batch;
+    char buffer[64 * 1024];
+    try
+    {
+        connect();
+        for (;;)
+        {
+            Clock::time_point now = Clock::now();
+            if (now >= bench_.end_)
+            {
+                break;
+            }
+
+            batch.clear();
+            while (due_.size() < bench_.arg_pipeline && (!open || next <= now))
+            {
+                batch += bench_.request_;
+                due_.push_back(open ? next : now);
+                next += interval;
+            }
+            if (!batch.empty())
+            {
+                socket_.sendBytes(batch.data(), static_cast<int>(batch.size()));
+            }
+
+            // Wake for the next response, the next request due, or the end.
+            Clock::time_point until = bench_.end_;
+            if (open && due_.size() < bench_.arg_pipeline)
+            {
+                until = std::min(until, next);
+            }
+            // poll() waits in whole milliseconds; nearer than that, check and
+            // nap briefly instead, so requests aren't sent late.
+            const Poco::UInt64 wait = Nanoseconds(until - now) / 1000;
+            if (wait < 1000)
+            {
+                if (!socket_.poll(Poco::Timespan(0), Poco::Net::Socket::SELECT_READ))
+                {
+                    std::this_thread::sleep_for(std::chrono::microseconds(std::min<Poco::UInt64>(wait, 50)));
+                    continue;
+                }
+            }
+            else if (!socket_.poll(Poco::Timespan(static_cast<Poco::Timespan::TimeDiff>(wait - wait % 1000)), Poco::Net::Socket::SELECT_READ))
+            {
+                continue;
+            }
+
+            const int n = socket_.receiveBytes(buffer, sizeof(buffer));
+            if (n > 0)
+            {
+                in_.append(buffer, static_cast<std::size_t>(n));
+            }
+            if (n <= 0 || !parse(Clock::now()))
+            {
+                // Closed by the server: whatever was in flight is lost.
+                errors_ += due_.size();
+                due_.clear();
+                ++reconnects_;
+                connect();
+            }
+        }
+    }
+    catch (const Poco::Exception &e)
+    {
+        std::cerr << "connection: " << e.displayText() << std::endl;
+        errors_ += due_.size();
+    }
+}
+
+bool Bench::Connection::parse(Clock::time_point now)
+{
+    std::size_t consumed = 0;
+    bool keepAlive = true;
+    while (!due_.empty())
+    {
+        const std::size_t headerEnd = in_.find("\r\n\r\n", consumed);
+        if (headerEnd == std::string::npos)
+        {
+            break;
+        }
+
+        std::size_t contentLength = 0;
+        for (std::size_t line = in_.find("\r\n", consumed); line < headerEnd; line = in_.find("\r\n", line + 2))
+        {
+            const char *text = in_.data() + line + 2;
+            const std::size_t length = headerEnd - line - 2;
+            if (StartsWithIgnoreCase(text, length, "content-length:"))
+            {
+                contentLength = static_cast<std::size_t>(std::strtoull(text + 15, nullptr, 10));
+            }
+            else if (StartsWithIgnoreCase(text, length, "connection: close"))
+            {
+                keepAlive = false;
+            }
+        }
+        const std::size_t end = headerEnd + 4 + contentLength;
+        if (in_.size() < end)
+        {
+            break;
+        }
+
+        // Only what was sent after the warm-up counts.
+        if (due_.front() >= bench_.start_)
+        {
+            latencies_.record(now > due_.front() ? Nanoseconds(now - due_.front()) : 0);
+            ++requests_;
+            bytes_ += end - consumed;
+            if (in_.compare(consumed, 10, "HTTP/1.1 2") != 0 && in_.compare(consumed, 10, "HTTP/1.0 2") != 0)
+            {
+                ++failed_;
+            }
+        }
+        due_.pop_front();
+        consumed = end;
+        if (!keepAlive)
+        {
+            break;
+        }
+    }
+    in_.erase(0, consumed);
+    return keepAlive;
+}
+
+void Bench::report(const std::vector<Poco::SharedPtr<Connection>> &connections, double seconds) const
+{
+    LatencyHistogram latencies;
+    Poco::UInt64 requests = 0;
+    Poco::UInt64 bytes = 0;
+    Poco::UInt64 failed = 0;
+    Poco::UInt64 errors = 0;
+    Poco::UInt64 reconnects = 0;
+    for (const auto &connection : connections)
+    {
+        latencies.merge(connection->latencies());
+        requests += connection->requests();
+        bytes += connection->bytes();
+        failed += connection->failed();
+        errors += connection->errors();
+        reconnects += connection->reconnects();
+    }
+
+    const std::ios::fmtflags flags(std::cout.flags());
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "requests    " << requests << " in " << seconds << " s, " << requests / seconds << " req/s, "
+              << bytes / seconds / (1024 * 1024) << " MB/s" << std::endl;
+    std::cout << "errors      " << failed << " non-2xx, " << errors << " lost, " << reconnects << " reconnects" << std::endl;
+    std::cout << std::setprecision(3);
+    std::cout << "latency     min " << latencies.min() / 1e6 << " ms, mean " << latencies.mean() / 1e6
+              << " ms, max " << latencies.max() / 1e6 << " ms" << std::endl;
+
+    // The spectrum halves the distance to 100% at each step, as HdrHistogram
+    // prints it, so the tail gets as many rows as the body.
+    std::cout << std::endl
+              << "  percentile      latency ms      count" << std::endl;
+    for (double missing = 0.5;; missing /= 2)
+    {
+        const double q = 1 - missing;
+        std::cout << std::setw(11) << std::setprecision(5) << q * 100 << "%"
+                  << std::setw(16) << std::setprecision(3) << latencies.percentile(q) / 1e6
+                  << std::setw(11) << static_cast<Poco::UInt64>(std::ceil(q * latencies.count())) << std::endl;
+        if (missing * latencies.count() < 1 || missing < 1e-6)
+        {
+            break;
+        }
+    }
+    std::cout << std::setw(11) << std::setprecision(5) << 100.0 << "%"
+              << std::setw(16) << std::setprecision(3) << latencies.max() / 1e6
+              << std::setw(11) << latencies.count() << std::endl;
+    std::cout.flags(flags);
+}
+
+int Bench::main(const std::vector<std::string> &arguments)
+{
+    if (arg_help || !arguments.empty())
+    {
+        Poco::Util::HelpFormatter formatter(options());
+        formatter.setCommand(commandName());
+        formatter.setUsage("[OPTION]...");
+        formatter.format(std::cout);
+        return arg_help ? EXIT_OK : EXIT_USAGE;
+    }
+
+    try
+    {
+        address_ = Poco::Net::SocketAddress(arg_host, arg_port);
+    }
+    catch (const Poco::Exception &e)
+    {
+        std::cerr << commandName() << ": " << e.displayText() << std::endl;
+        return EXIT_USAGE;
+    }
+
+    request_ = "GET " + arg_path + " HTTP/1.1\r\nHost: " + address_.toString() + "\r\n";
+    if (!arg_accept.empty())
+    {
+        request_ += "Accept: " + arg_accept + "\r\n";
+    }
+    request_ += "\r\n";
+
+    std::cout << commandName() << ": " << arg_connections << " connections, pipeline " << arg_pipeline << ", ";
+    if (arg_rate > 0)
+    {
+        std::cout << arg_rate << " req/s open loop";
+    }
+    else
+    {
+        std::cout << "closed loop";
+    }
+    std::cout << ", " << arg_duration << " s against http://" << address_.toString() << arg_path << std::endl;
+
+    start_ = Clock::now() + std::chrono::seconds(arg_warmup);
+    end_ = start_ + std::chrono::seconds(arg_duration);
+
+    // Open-loop schedules are staggered so the connections don't all send at
+    // the same instant.
+    std::vector<Poco::SharedPtr<Connection>> connections;
+    const Clock::duration stagger = arg_rate > 0 ? std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds(1000000000ULL / arg_rate)) : Clock::duration::zero();
+    Poco::ThreadPool pool(1, static_cast<int>(arg_connections));
+    for (unsigned i = 0; i < arg_connections; ++i)
+    {
+        Poco::SharedPtr<Connection> connection(new Connection(*this, stagger * i));
+        connections.push_back(connection);
+        pool.start(*connection);
+    }
+    pool.joinAll();
+
+    report(connections, arg_duration);
+    return EXIT_OK;
+}
+
+POCO_APP_MAIN(Bench)
@@ -1,8 +1,8 @@
 // Application
 #include <Poco/Util/ServerApplication.h>
 
-// Crypt
-#include <Poco/Random.h>
+// Core
+#include <Poco/NumberFormatter.h>
 
 // HTTPServer
 #include <Poco/Net/HTTPServer.h>
@@ -11,63 +11,145 @@
 #include <Poco/Net/HTTPServerRequest.h>
 #include <Poco/Net/HTTPServerResponse.h>
 
+// Sockets
+#include <Poco/Net/ServerSocket.h>
+
+// Threading
+#include <Poco/ThreadPool.h>
+
 // Streams
 #include <Poco/FileStream.h>
 
-class FortuneRequestHandler : public Poco::Net::HTTPRequestHandler
+#include <memory>
+#include <vector>
+
+#include "FortuneCorpus.h"
+#include "FortuneEndpoints.h"
+#include "Metrics.h"
+#include "Rcu.h"
+#include "ReactorServer.h"
+#include "ServerSettings.h"
+
+namespace
+{
+    // Handlers freed on this thread, for the next ones it creates.
+    struct HandlerPool
+    {
+        static const std::size_t CAPACITY = 16;
+
+        std::vector<void *> free;
+
+        ~HandlerPool()
+        {
+            for (void *handler : free)
+            {
+                ::operator delete(handler);
+            }
+        }
+    };
+
+    thread_local HandlerPool handlerPool;
+}
+
+// Routes a request and sends its endpoint's reply.
+//
+// HTTPServer creates and deletes a handler for every request on the connection
+// thread; they come from a per-thread pool rather than the heap.
+class RouteRequestHandler final : public Poco::Net::HTTPRequestHandler
 {
 public:
-    FortuneRequestHandler()
+    RouteRequestHandler(const Router &router, Metrics &metrics, Rcu &rcu) : router_(router), metrics_(metrics), rcu_(rcu)
+    {
+    }
+
+    static void *operator new(std::size_t size)
+    {
+        HandlerPool &pool = handlerPool;
+        if (pool.free.empty())
+        {
+            return ::operator new(size);
+        }
+        void *handler = pool.free.back();
+        pool.free.pop_back();
+        return handler;
+    }
+
+    static void operator delete(void *handler)
     {
-        const std::vector<std::string> fortunes{
-            {"The first principle is that you must not fool yourself -- and you are the easiest person to fool. -- Richard Feynman",
-             "The greater danger for most of us lies not in setting our aim too high and falling short; but in setting our aim too low, and achieving our mark. -- Michelangelo",
-             "A friend is someone who understands your past, believes in your future, and accepts you just the way you are.",
-             "Be kind, for everyone you meet is fighting a hard battle. -- Plato",
-             "Happiness is when what you think, what you say, and what you do are in harmony. -- Gandhi",
-             "We must accept finite disappointment, but never lose infinite hope. -- Martin Luther King Jr."}};
-
-        Poco::Random random;
-        fortune_ = {fortunes.at(random.next(fortunes.size()))};
+        HandlerPool &pool = handlerPool;
+        if (pool.free.size() < HandlerPool::CAPACITY)
+        {
+            pool.free.push_back(handler);
+        }
+        else
+        {
+            ::operator delete(handler);
+        }
     }
 
     void handleRequest(Poco::Net::HTTPServerRequest &request, Poco::Net::HTTPServerResponse &response)
     {
-        response.setChunkedTransferEncoding(true);
-        response.setContentType("text/html");
-
-        std::ostream &ostr = response.send();
-        ostr << "<html>";
-        ostr << "<head>";
-        ostr << "<title>Fortunes</title>";
-        ostr << "</head>";
-        ostr << "<body>";
-        ostr << "<p style=\"text-align: center; font-size: 48px;\">";
-        ostr << fortune_;
-        ostr << "</p>";
-        ostr << "<p style=\"text-align: left; font-size: 12px;\">";
-        ostr << "Client address: " << request.clientAddress().toString();
-        ostr << "</p>";
-        ostr << "</body>";
-        ostr << "</html>";
+        // Reused across requests on this thread, so a response costs no
+        // allocation once they have grown to the longest reply.
+        static thread_local Reply reply;
+        static thread_local std::string body;
+        const Metrics::Timer timer;
+        const Rcu::ReadGuard guard(rcu_);
+
+        const Router::Method method = Router::parseMethod(request.getMethod());
+        const std::string &uri = request.getURI();
+        Router::Match match;
+        router_.match(method, uri.data(), uri.size(), match);
+
+        const std::string address = request.clientAddress().toString();
+        const std::string *accept = request.has("Accept") ? &request.get("Accept") : nullptr;
+        const Endpoint::Request endpointRequest = {method, match, address, accept ? accept->data() : nullptr, accept ? accept->size() : 0};
+        Endpoint::dispatch(endpointRequest, reply);
+
+        body.clear();
+        for (std::size_t i = 0; i < reply.pieces(); ++i)
+        {
+            body.append(reply.data(i), reply.length(i));
+        }
+
+        // sendBuffer() sets the Content-Length, and leaves out the body for HEAD.
+        response.setStatusAndReason(static_cast<Poco::Net::HTTPResponse::HTTPStatus>(reply.status()), reply.reason());
+        response.setContentType(reply.contentType());
+        if (reply.allow())
+        {
+            response.set("Allow", reply.allow());
+        }
+        if (reply.vary())
+        {
+            response.set("Vary", reply.vary());
+        }
+        response.sendBuffer(body.data(), body.size());
+        metrics_.record(reply.status(), timer.elapsed());
     }
 
-    std::string fortune_;
+private:
+    const Router &router_;
+    Metrics &metrics_;
+    Rcu &rcu_;
 };
 
 class FortuneRequestHandlerFactory : public Poco::Net::HTTPRequestHandlerFactory
 {
 public:
-    Poco::Net::HTTPRequestHandler *createRequestHandler(const Poco::Net::HTTPServerRequest &request)
+    FortuneRequestHandlerFactory(const Router &router, Metrics &metrics, Rcu &rcu) : router_(router), metrics_(metrics), rcu_(rcu)
     {
-        // Ideally, would check getMethod() as well.
-        if (request.getURI() == "/")
-        {
-            return new FortuneRequestHandler;
-        }
+    }
 
-        return 0;
+    Poco::Net::HTTPRequestHandler *createRequestHandler(const Poco::Net::HTTPServerRequest &)
+    {
+        // Every request gets a handler; unknown paths get the router's 404.
+        return new RouteRequestHandler(router_, metrics_, rcu_);
     }
+
+private:
+    const Router &router_;
+    Metrics &metrics_;
+    Rcu &rcu_;
 };
 
 class FortuneServerApplication : public Poco::Util::ServerApplication
@@ -92,13 +174,65 @@ protected:
 
     int main(const std::vector<std::string> &args)
     {
-        unsigned short port = config().getUInt("FortuneServer.port", 9999);
+        const ServerSettings settings = ServerSettings::fromConfig(config());
+        // Before the servers and their threads, which record and read
+        // through them.
+        Metrics metrics;
+        Rcu rcu;
+
+        // Request threads read the current snapshot without locking; a
+        // changed file is swapped in while they run.
+        const std::string fortunes = config().getString("FortuneServer.fortunes", "");
+        const long reloadMilliseconds = config().getInt("FortuneServer.reloadInterval", 2) * 1000L;
+        FortuneCorpus corpus(fortunes, reloadMilliseconds, rcu, logger());
+        const FortuneRoutes routes(corpus, metrics);
+
+        if (settings.engine == "reactor")
+        {
+            ReactorServer server(routes.router(), settings, metrics, rcu);
+            metrics.addGauge("fortune_reactor_connections", "Open connections.", [&server]() {
+                return static_cast<Poco::Int64>(server.connections());
+            });
+            metrics.addCounter("fortune_reactor_connections_total", "Connections accepted.", [&server]() {
+                return static_cast<Poco::Int64>(server.accepted());
+            });
+            server.start();
+            logger().information("listening: " + settings.describe());
+            waitForTerminationRequest();
+            server.stop();
+            metrics.removeReadings();
+            return Application::EXIT_OK;
+        }
+
+        // Declared before the server, which must stop using it first.
+        Poco::ThreadPool pool("fortune", settings.minThreads, settings.maxThreads, settings.threadIdleTime, settings.stackSize);
+        Poco::Net::ServerSocket socket(settings.port, settings.backlog);
 
         // The server takes ownership of the HTTPRequstHandlerFactory
-        Poco::Net::HTTPServer server(new FortuneRequestHandlerFactory, port);
+        Poco::Net::HTTPServer server(new FortuneRequestHandlerFactory(routes.router(), metrics, rcu), pool, socket, settings.params);
+        metrics.addGauge("fortune_http_threads", "Connection threads in use.", [&server]() {
+            return static_cast<Poco::Int64>(server.currentThreads());
+        });
+        metrics.addGauge("fortune_http_queued_connections", "Accepted connections waiting for a thread.", [&server]() {
+            return static_cast<Poco::Int64>(server.queuedConnections());
+        });
+        metrics.addCounter("fortune_http_refused_connections_total", "Connections refused with the queue full.", [&server]() {
+            return static_cast<Poco::Int64>(server.refusedConnections());
+        });
+        metrics.addGauge("fortune_http_connections", "Connections being served.", [&server]() {
+            return static_cast<Poco::Int64>(server.currentConnections());
+        });
+        metrics.addCounter("fortune_http_connections_total", "Connections accepted.", [&server]() {
+            return static_cast<Poco::Int64>(server.totalConnections());
+        });
         server.start();
+        logger().information("listening: " + settings.describe());
         waitForTerminationRequest();
-        server.stop();
+        // Keep-alive connections would go on serving, /metrics included,
+        // until the pool is destroyed after the server: abort them, and
+        // drop the readings that call into the server.
+        server.stopAll(true);
+        metrics.removeReadings();
 
         return Application::EXIT_OK;
     }
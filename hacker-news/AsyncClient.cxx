@@ -0,0 +1,521 @@
+#include "AsyncClient.h"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <vector>
+
+// Package: Core
+#include <Poco/NumberFormatter.h>
+
+// Package: NetCore
+#include <Poco/Net/NetException.h>
+
+// Package: Sockets
+#include <Poco/Net/PollSet.h>
+
+// Package: SSLSockets
+#include <Poco/Net/SecureStreamSocket.h>
+
+// Package: Threading
+#include <Poco/Runnable.h>
+#include <Poco/Thread.h>
+
+#include "ResponseParser.h"
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    // How long a loop with room for more requests waits before asking the
+    // handler again, as another loop's responses may have led to more.
+    const Clock::duration IDLE_WAIT = std::chrono::milliseconds(10);
+
+    const std::size_t BUFFER_SIZE = 16 * 1024;
+
+    Poco::Timespan ToTimespan(Clock::duration duration)
+    {
+        const auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+        return Poco::Timespan(static_cast<Poco::Timespan::TimeDiff>(std::max<decltype(microseconds)>(microseconds, 0)));
+    }
+}
+
+// A request on a connection.
+struct AsyncClient::Pending
+{
+    Request request;
+    bool retried = false; // has been sent once already
+    Clock::time_point deadline;
+};
+
+struct AsyncClient::Connection
+{
+    enum State
+    {
+        CONNECTING,
+        HANDSHAKING,
+        OPEN
+    };
+
+    explicit Connection(const Poco::Net::SecureStreamSocket &socket)
+        : socket(socket), state(CONNECTING), sent(0), answered(0)
+    {
+    }
+
+    Poco::Net::SecureStreamSocket socket;
+    State state;
+    std::string out; // requests not yet sent, from `sent` on
+    std::size_t sent;
+    ResponseParser parser; // for pending.front()
+    std::deque<Pending> pending; // sent or queued, oldest first
+    unsigned answered;
+};
+
+// One thread's connections, and the requests on them.
+class AsyncClient::Loop : public Poco::Runnable
+{
+public:
+    Loop(AsyncClient &client, Handler &handler, unsigned limit)
+        : client_(client), handler_(handler), limit_(limit), depth_(std::max(1u, client.options_.pipeline)), active_(0)
+    {
+    }
+
+    void run() override;
+
+private:
+    Loop(const Loop &);
+    Loop &operator=(const Loop &);
+
+    void fill();
+    Connection *start(Pending &pending);
+    Connection &connect();
+
+    // Moves a connection on after poll() found it ready for `mode`.
+    void ready(Connection &connection, int mode);
+    void handshake(Connection &connection);
+
+    // Sends what's queued and reads what has arrived. Returns false if the
+    // connection was closed.
+    bool transfer(Connection &connection);
+    bool complete(Connection &connection);
+
+    // Closes a connection, failing or retrying whatever was on it.
+    void fail(Connection &connection, const std::string &error, bool timedOut = false);
+    void close(Connection &connection);
+    void expire();
+    void deliver(const Request &request, const Response &response);
+    Poco::Timespan wait() const;
+
+    AsyncClient &client_;
+    Handler &handler_;
+    const unsigned limit_; // this loop's share of maxInFlight
+    unsigned depth_; // requests a connection may have in flight
+    Poco::Net::PollSet pollSet_;
+    std::map<Poco::Net::Socket, std::unique_ptr<Connection>> connections_;
+    std::deque<Pending> retries_;
+    unsigned active_; // requests taken and not yet answered
+};
+
+void AsyncClient::Loop::run()
+{
+    for (;;)
+    {
+        fill();
+        if (active_ == 0 && handler_.finished())
+        {
+            break;
+        }
+
+        const Poco::Net::PollSet::SocketModeMap events = pollSet_.poll(wait());
+        for (const auto &event : events)
+        {
+            const auto it = connections_.find(event.first);
+            if (it != connections_.end())
+            {
+                ready(*it->second, event.second);
+            }
+        }
+        expire();
+    }
+
+    while (!connections_.empty())
+    {
+        close(*connections_.begin()->second);
+    }
+}
+
+void AsyncClient::Loop::fill()
+{
+    // Requests are queued first and sent together, so a pipelined
+    // connection's go out in one write.
+    std::vector<Connection *> queued;
+    while (active_ < limit_)
+    {
+        Pending pending;
+        if (!retries_.empty())
+        {
+            pending = retries_.front();
+            retries_.pop_front();
+        }
+        else if (!handler_.next(pending.request))
+        {
+            break;
+        }
+
+        Connection *connection = start(pending);
+        if (connection && std::find(queued.begin(), queued.end(), connection) == queued.end())
+        {
+            queued.push_back(connection);
+        }
+    }
+
+    for (Connection *connection : queued)
+    {
+        if (connection->state == Connection::OPEN)
+        {
+            ready(*connection, Poco::Net::PollSet::POLL_WRITE);
+        }
+    }
+}
+
+AsyncClient::Connection *AsyncClient::Loop::start(Pending &pending)
+{
+    // The first connection with room, so pipelines fill up. A retry only goes
+    // on a new one, as another that has been open a while may be as stale as
+    // the last.
+    Connection *connection = nullptr;
+    for (const auto &entry : connections_)
+    {
+        Connection &candidate = *entry.second;
+        if (candidate.pending.size() < depth_ && (!pending.retried || candidate.answered == 0))
+        {
+            connection = &candidate;
+            break;
+        }
+    }
+    if (!connection)
+    {
+        try
+        {
+            connection = &connect();
+        }
+        catch (const Poco::Exception &e)
+        {
+            Response response;
+            response.error = e.displayText();
+            deliver(pending.request, response);
+            return nullptr;
+        }
+    }
+
+    ++active_;
+    pending.deadline = Clock::now() + std::chrono::microseconds(client_.options_.timeout.totalMicroseconds());
+    connection->out += "GET ";
+    connection->out += pending.request.path;
+    connection->out += client_.requestSuffix_;
+    connection->pending.push_back(pending);
+    return connection;
+}
+
+AsyncClient::Connection &AsyncClient::Loop::connect()
+{
+    Poco::Net::SecureStreamSocket socket(client_.sessions_.context(), client_.sessions_.tlsSession(client_.host_, client_.port_));
+    socket.setPeerHostName(client_.host_);
+    socket.setLazyHandshake(true);
+    socket.connectNB(client_.address_);
+
+    std::unique_ptr<Connection> connection(new Connection(socket));
+    Connection &result = *connection;
+    connections_[socket] = std::move(connection);
+    pollSet_.add(socket, Poco::Net::PollSet::POLL_WRITE);
+    return result;
+}
+
+void AsyncClient::Loop::ready(Connection &connection, int mode)
+{
+    try
+    {
+        // A failed connect is left to the handshake, which says why.
+        if ((mode & Poco::Net::PollSet::POLL_ERROR) && connection.state != Connection::CONNECTING)
+        {
+            throw Poco::Net::NetException("Socket error");
+        }
+
+        switch (connection.state)
+        {
+        case Connection::CONNECTING:
+            connection.state = Connection::HANDSHAKING;
+            handshake(connection);
+            break;
+
+        case Connection::HANDSHAKING:
+            handshake(connection);
+            break;
+
+        case Connection::OPEN:
+            transfer(connection);
+            break;
+        }
+    }
+    catch (const Poco::Exception &e)
+    {
+        fail(connection, e.displayText());
+    }
+}
+
+void AsyncClient::Loop::handshake(Connection &connection)
+{
+    const int result = connection.socket.completeHandshake();
+    if (result == Poco::Net::SecureStreamSocket::ERR_SSL_WANT_READ)
+    {
+        pollSet_.update(connection.socket, Poco::Net::PollSet::POLL_READ);
+        return;
+    }
+    if (result == Poco::Net::SecureStreamSocket::ERR_SSL_WANT_WRITE)
+    {
+        pollSet_.update(connection.socket, Poco::Net::PollSet::POLL_WRITE);
+        return;
+    }
+
+    client_.sessions_.setTlsSession(client_.host_, client_.port_, connection.socket.currentSession());
+    connection.state = Connection::OPEN;
+    transfer(connection);
+}
+
+bool AsyncClient::Loop::transfer(Connection &connection)
+{
+    bool wantWrite = false;
+    while (connection.sent < connection.out.size())
+    {
+        const int n = connection.socket.sendBytes(connection.out.data() + connection.sent, static_cast<int>(connection.out.size() - connection.sent));
+        if (n < 0)
+        {
+            wantWrite = n != Poco::Net::SecureStreamSocket::ERR_SSL_WANT_READ;
+            break;
+        }
+        connection.sent += static_cast<std::size_t>(n);
+    }
+    if (connection.sent == connection.out.size())
+    {
+        connection.out.clear();
+        connection.sent = 0;
+    }
+
+    // Read until the socket would block: TLS may hold decrypted data that
+    // poll() can't see.
+    char buffer[BUFFER_SIZE];
+    for (;;)
+    {
+        const int n = connection.socket.receiveBytes(buffer, static_cast<int>(sizeof(buffer)));
+        if (n < 0)
+        {
+            wantWrite = wantWrite || n == Poco::Net::SecureStreamSocket::ERR_SSL_WANT_WRITE;
+            break;
+        }
+        if (n == 0)
+        {
+            // Closed by the server: that may end a response, and anything
+            // after it goes again elsewhere.
+            if (!connection.pending.empty() && connection.parser.close())
+            {
+                if (complete(connection))
+                {
+                    fail(connection, "Connection closed");
+                }
+                return false;
+            }
+            fail(connection, "Connection closed before the response was complete");
+            return false;
+        }
+
+        // Pipelined responses may share a read.
+        std::size_t used = 0;
+        while (used < static_cast<std::size_t>(n))
+        {
+            if (connection.pending.empty())
+            {
+                throw Poco::Net::MessageException("Response to no request");
+            }
+            used += connection.parser.parse(buffer + used, static_cast<std::size_t>(n) - used);
+            if (connection.parser.complete() && !complete(connection))
+            {
+                return false;
+            }
+        }
+    }
+
+    // Always readable, even when idle, to see the server closing.
+    pollSet_.update(connection.socket, Poco::Net::PollSet::POLL_READ | (wantWrite || connection.sent < connection.out.size() ? Poco::Net::PollSet::POLL_WRITE : 0));
+    return true;
+}
+
+bool AsyncClient::Loop::complete(Connection &connection)
+{
+    const Request request = connection.pending.front().request;
+    connection.pending.pop_front();
+    ++connection.answered;
+    --active_;
+
+    Response response;
+    response.status = connection.parser.status();
+    response.body.swap(connection.parser.body());
+    const bool keepAlive = connection.parser.keepAlive();
+    connection.parser.reset();
+
+    // The server won't answer anything sent after this; those requests go
+    // again, on another connection, without counting as a failure.
+    if (!keepAlive)
+    {
+        for (Pending &pending : connection.pending)
+        {
+            --active_;
+            retries_.push_back(pending);
+        }
+        connection.pending.clear();
+        close(connection);
+    }
+
+    deliver(request, response);
+    return keepAlive;
+}
+
+void AsyncClient::Loop::fail(Connection &connection, const std::string &error, bool timedOut)
+{
+    std::deque<Pending> pending;
+    pending.swap(connection.pending);
+    const bool started = connection.parser.started();
+    const bool reused = connection.answered > 0;
+
+    // A server that drops a connection with a pipeline on it may not cope
+    // with pipelining; send one request at a time from now on.
+    if (pending.size() > 1 && !timedOut)
+    {
+        depth_ = 1;
+    }
+    close(connection);
+
+    for (std::size_t i = 0; i < pending.size(); ++i)
+    {
+        --active_;
+
+        // A server may reset a connection over requests pipelined behind a
+        // response it closes after, so all of a pipeline goes again, even
+        // the part-answered first request. A lone request is retried only if
+        // its connection may have gone stale while idle. Nothing is retried
+        // from a server that has stalled altogether, and a GET can safely go
+        // again, but just the once.
+        const bool retry = !pending[i].retried && !timedOut && (pending.size() > 1 || (reused && !started));
+        if (retry)
+        {
+            pending[i].retried = true;
+            retries_.push_back(pending[i]);
+        }
+        else
+        {
+            Response response;
+            response.error = i == 0 || timedOut ? error : "Connection closed";
+            deliver(pending[i].request, response);
+        }
+    }
+}
+
+void AsyncClient::Loop::close(Connection &connection)
+{
+    const Poco::Net::Socket socket = connection.socket;
+    pollSet_.remove(socket);
+    try
+    {
+        connection.socket.close();
+    }
+    catch (const Poco::Exception &)
+    {
+    }
+    connections_.erase(socket);
+}
+
+void AsyncClient::Loop::expire()
+{
+    const Clock::time_point now = Clock::now();
+    std::vector<Connection *> expired;
+    for (const auto &entry : connections_)
+    {
+        if (!entry.second->pending.empty() && entry.second->pending.front().deadline <= now)
+        {
+            expired.push_back(entry.second.get());
+        }
+    }
+    for (Connection *connection : expired)
+    {
+        fail(*connection, "Timed out", true);
+    }
+}
+
+void AsyncClient::Loop::deliver(const Request &request, const Response &response)
+{
+    try
+    {
+        handler_.handle(request, response);
+    }
+    catch (const Poco::Exception &e)
+    {
+        std::cerr << e.displayText() << std::endl;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+    }
+}
+
+Poco::Timespan AsyncClient::Loop::wait() const
+{
+    const Clock::time_point now = Clock::now();
+    Clock::time_point until = now + (active_ < limit_ ? IDLE_WAIT : std::chrono::microseconds(client_.options_.timeout.totalMicroseconds()));
+    for (const auto &entry : connections_)
+    {
+        if (!entry.second->pending.empty())
+        {
+            until = std::min(until, entry.second->pending.front().deadline);
+        }
+    }
+    return ToTimespan(until - now);
+}
+
+AsyncClient::AsyncClient(SessionPool &sessions, const std::string &host, Poco::UInt16 port, const Options &options)
+    : sessions_(sessions), host_(host), port_(port), options_(options), address_(host, port)
+{
+    requestSuffix_ = " HTTP/1.1\r\nHost: ";
+    requestSuffix_ += host;
+    if (port != 443)
+    {
+        requestSuffix_ += ':';
+        Poco::NumberFormatter::append(requestSuffix_, static_cast<unsigned>(port));
+    }
+    requestSuffix_ += "\r\n\r\n";
+}
+
+AsyncClient::~AsyncClient()
+{
+}
+
+void AsyncClient::run(Handler &handler)
+{
+    const unsigned threads = std::max(1u, options_.threads);
+    const unsigned maxInFlight = std::max(threads, options_.maxInFlight);
+
+    std::vector<std::unique_ptr<Loop>> loops;
+    std::vector<std::unique_ptr<Poco::Thread>> running;
+    for (unsigned i = 0; i < threads; ++i)
+    {
+        // Shares of the limit differ by one at most.
+        loops.emplace_back(new Loop(*this, handler, maxInFlight / threads + (i < maxInFlight % threads ? 1 : 0)));
+        running.emplace_back(new Poco::Thread);
+        running.back()->start(*loops.back());
+    }
+    for (auto &thread : running)
+    {
+        thread->join();
+    }
+}
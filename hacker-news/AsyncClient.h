@@ -0,0 +1,88 @@
+#pragma once
+
+#include <string>
+
+// Package: Foundation
+#include <Poco/Timespan.h>
+
+// Package: NetCore
+#include <Poco/Net/SocketAddress.h>
+
+#include "SessionPool.h"
+
+// An event-driven HTTPS client for one server: a few loop threads, each
+// polling its own non-blocking connections, keep many GETs in flight without
+// a thread apiece.
+//
+// Requests come from a Handler, which each loop asks for more whenever it has
+// room under its share of the concurrency limit; each response goes back to
+// the Handler on the loop that read it. A request's timeout covers connecting,
+// the TLS handshake and the whole response; one that runs out fails and its
+// connection is closed. Connections are kept open between requests, and new
+// ones resume a TLS session through the SessionPool.
+//
+// With a pipeline depth above one, up to that many requests are written to a
+// connection back to back, without waiting for the responses, which come back
+// in order. If the server closes a connection part-way through a pipeline, the
+// requests it didn't answer go again and the loop stops pipelining.
+class AsyncClient
+{
+public:
+    struct Options
+    {
+        unsigned threads = 2;
+        unsigned maxInFlight = 64;
+        unsigned pipeline = 1; // requests in flight on one connection
+        Poco::Timespan timeout = Poco::Timespan(10, 0);
+    };
+
+    struct Request
+    {
+        std::string path;
+        unsigned id = 0; // the Handler's own, handed back with the response
+    };
+
+    struct Response
+    {
+        int status = 0;
+        std::string body;
+        std::string error; // why there's no response, or empty
+    };
+
+    // Called from every loop at once, so it must be thread-safe.
+    class Handler
+    {
+    public:
+        virtual ~Handler() {}
+
+        // The next request to send, or false if there's none for now.
+        virtual bool next(Request &request) = 0;
+
+        // True once next() will never have another request.
+        virtual bool finished() const = 0;
+
+        virtual void handle(const Request &request, const Response &response) = 0;
+    };
+
+    AsyncClient(SessionPool &sessions, const std::string &host, Poco::UInt16 port, const Options &options);
+    ~AsyncClient();
+
+    // Sends the handler's requests until it's finished and every one has been
+    // answered.
+    void run(Handler &handler);
+
+private:
+    AsyncClient(const AsyncClient &);
+    AsyncClient &operator=(const AsyncClient &);
+
+    struct Pending;
+    struct Connection;
+    class Loop;
+
+    SessionPool &sessions_;
+    const std::string host_;
+    const Poco::UInt16 port_;
+    const Options options_;
+    const Poco::Net::SocketAddress address_; // resolved once
+    std::string requestSuffix_; // what follows the path in every request
+};
@@ -0,0 +1,178 @@
+#include "ResponseParser.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+// Package: HTTP
+#include <Poco/Net/HTTPResponse.h>
+
+// Package: NetCore
+#include <Poco/Net/NetException.h>
+
+ResponseParser::ResponseParser()
+{
+    reset();
+}
+
+std::size_t ResponseParser::parse(const char *data, std::size_t length)
+{
+    const char *p = data;
+    const char *const end = data + length;
+    while (p < end && state_ != COMPLETE)
+    {
+        switch (state_)
+        {
+        case HEADER:
+            if (line(p, end))
+            {
+                header_ += line_;
+                if (header_.size() > MAX_HEADER)
+                {
+                    throw Poco::Net::MessageException("Response header too long");
+                }
+                if (blankLine())
+                {
+                    parseHeader();
+                }
+                line_.clear();
+            }
+            break;
+
+        case BODY:
+        case CHUNK_DATA:
+        {
+            const std::size_t n = static_cast<std::size_t>(std::min<Poco::UInt64>(remaining_, static_cast<Poco::UInt64>(end - p)));
+            body_.append(p, n);
+            p += n;
+            remaining_ -= n;
+            if (remaining_ == 0)
+            {
+                state_ = state_ == BODY ? COMPLETE : CHUNK_END;
+            }
+            break;
+        }
+
+        case CHUNK_SIZE:
+            if (line(p, end))
+            {
+                parseChunkSize();
+                line_.clear();
+            }
+            break;
+
+        case CHUNK_END:
+            if (line(p, end))
+            {
+                if (!blankLine())
+                {
+                    throw Poco::Net::MessageException("Malformed chunked body");
+                }
+                state_ = CHUNK_SIZE;
+                line_.clear();
+            }
+            break;
+
+        case TRAILER:
+            if (line(p, end))
+            {
+                if (blankLine())
+                {
+                    state_ = COMPLETE;
+                }
+                line_.clear();
+            }
+            break;
+
+        case UNTIL_CLOSE:
+            body_.append(p, static_cast<std::size_t>(end - p));
+            p = end;
+            break;
+
+        case COMPLETE:
+            break;
+        }
+    }
+    return static_cast<std::size_t>(p - data);
+}
+
+bool ResponseParser::close()
+{
+    if (state_ == UNTIL_CLOSE)
+    {
+        state_ = COMPLETE;
+    }
+    return state_ == COMPLETE;
+}
+
+void ResponseParser::reset()
+{
+    state_ = HEADER;
+    line_.clear();
+    header_.clear();
+    body_.clear();
+    remaining_ = 0;
+    status_ = 0;
+    keepAlive_ = false;
+}
+
+bool ResponseParser::line(const char *&data, const char *end)
+{
+    const char *newline = static_cast<const char *>(std::memchr(data, '\n', static_cast<std::size_t>(end - data)));
+    const char *stop = newline ? newline + 1 : end;
+    line_.append(data, static_cast<std::size_t>(stop - data));
+    data = stop;
+    if (line_.size() > MAX_HEADER)
+    {
+        throw Poco::Net::MessageException("Response line too long");
+    }
+    return newline != nullptr;
+}
+
+void ResponseParser::parseHeader()
+{
+    std::istringstream in(header_);
+    Poco::Net::HTTPResponse response;
+    response.read(in);
+    header_.clear();
+
+    status_ = response.getStatus();
+    keepAlive_ = response.getKeepAlive();
+    if (status_ / 100 == 1)
+    {
+        // Interim; the real response follows.
+        status_ = 0;
+    }
+    else if (response.getChunkedTransferEncoding())
+    {
+        state_ = CHUNK_SIZE;
+    }
+    else if (response.hasContentLength())
+    {
+        remaining_ = static_cast<Poco::UInt64>(response.getContentLength64());
+        state_ = remaining_ ? BODY : COMPLETE;
+    }
+    else if (status_ == Poco::Net::HTTPResponse::HTTP_NO_CONTENT || status_ == Poco::Net::HTTPResponse::HTTP_NOT_MODIFIED)
+    {
+        state_ = COMPLETE;
+    }
+    else
+    {
+        // No length: the body runs until the server closes the connection.
+        state_ = UNTIL_CLOSE;
+        keepAlive_ = false;
+    }
+}
+
+void ResponseParser::parseChunkSize()
+{
+    char *stop = nullptr;
+    const unsigned long long size = std::strtoull(line_.c_str(), &stop, 16);
+    if (stop == line_.c_str())
+    {
+        throw Poco::Net::MessageException("Malformed chunk size");
+    }
+    remaining_ = size;
+    state_ = size ? CHUNK_DATA : TRAILER;
+}
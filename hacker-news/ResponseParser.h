@@ -0,0 +1,69 @@
+#pragma once
+
+#include <string>
+
+// Package: Core
+#include <Poco/Types.h>
+
+// Reads an HTTP response incrementally, as it arrives on a non-blocking
+// socket.
+//
+// The header is collected whole and handed to Poco::Net::HTTPResponse; the
+// body is taken by Content-Length, in chunks, or up to the connection closing.
+// Throws Poco::Net::MessageException for anything that isn't a response.
+class ResponseParser
+{
+public:
+    ResponseParser();
+
+    // Consumes the start of `data`, stopping at the end of the response.
+    // Returns how much it used.
+    std::size_t parse(const char *data, std::size_t length);
+
+    // The connection has closed, which completes a body that runs up to the
+    // close. Returns false if that leaves the response cut short.
+    bool close();
+
+    // Ready for the next response on the connection.
+    void reset();
+
+    bool started() const { return state_ != HEADER || !line_.empty() || !header_.empty(); }
+    bool complete() const { return state_ == COMPLETE; }
+
+    // Valid once the response is complete.
+    int status() const { return status_; }
+    bool keepAlive() const { return keepAlive_; }
+    const std::string &body() const { return body_; }
+    std::string &body() { return body_; }
+
+private:
+    enum State
+    {
+        HEADER,
+        BODY,
+        CHUNK_SIZE,
+        CHUNK_DATA,
+        CHUNK_END,
+        TRAILER,
+        UNTIL_CLOSE,
+        COMPLETE
+    };
+
+    static const std::size_t MAX_HEADER = 64 * 1024;
+
+    // Adds to line_ up to and including a newline. Returns true once line_
+    // holds a whole line.
+    bool line(const char *&data, const char *end);
+    bool blankLine() const { return line_ == "\r\n" || line_ == "\n"; }
+
+    void parseHeader();
+    void parseChunkSize();
+
+    State state_;
+    std::string line_;
+    std::string header_;
+    std::string body_;
+    Poco::UInt64 remaining_; // of the body or the current chunk
+    int status_;
+    bool keepAlive_;
+};
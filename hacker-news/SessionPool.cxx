@@ -0,0 +1,122 @@
+#include "SessionPool.h"
+
+#include <utility>
+
+// Package: Core
+#include <Poco/NumberFormatter.h>
+
+SessionPool::Lease::Lease(SessionPool &pool, const std::string &key, std::unique_ptr<Poco::Net::HTTPSClientSession> session, bool reused)
+    : pool_(&pool), key_(key), session_(std::move(session)), reused_(reused)
+{
+}
+
+SessionPool::Lease::Lease(Lease &&other)
+    : pool_(other.pool_), key_(std::move(other.key_)), session_(std::move(other.session_)), reused_(other.reused_)
+{
+}
+
+SessionPool::Lease::~Lease()
+{
+    if (session_)
+    {
+        pool_->release(key_, std::move(session_));
+    }
+}
+
+SessionPool::SessionPool(const Poco::Timespan &timeout, std::size_t maxIdlePerHost)
+    : timeout_(timeout), maxIdle_(maxIdlePerHost)
+{
+    // sendRequest may show:
+    //
+    // WARNING: Certificate verification failed
+    // ----------------------------------------
+    // Issuer Name:  C=BE,O=GlobalSign nv-sa,OU=Root CA,CN=GlobalSign Root CA
+    // Subject Name: C=US,O=Google Trust Services LLC,CN=GTS Root R1
+    //
+    // The certificate yielded the error: unable to get local issuer certificate
+    //
+    // The error occurred in the certificate chain at position 2
+    // Accept the certificate (y,n)?
+    //
+    // Why?
+    // Due to intermediate certificates in its chain, so you will have to add all the intermediate CAs
+    //  presented to your trusted store to get this to work. If you don't want to perform certificate
+    // verification, use VERIFY_NONE by passing context object to HTTPSClientSession ctor.
+    context_ = new Poco::Net::Context(
+        Poco::Net::Context::TLS_CLIENT_USE, // usage
+        "",                                 // caLocation
+        Poco::Net::Context::VERIFY_NONE     // verificationMode (default: VERIFY_RELAXED)
+    );
+
+    // Lets a new session resume the TLS session of an earlier one.
+    context_->enableSessionCache(true);
+}
+
+SessionPool::~SessionPool()
+{
+}
+
+SessionPool::Lease SessionPool::acquire(const std::string &host, Poco::UInt16 port)
+{
+    const std::string key = keyOf(host, port);
+    Poco::Net::Session::Ptr tls;
+    {
+        Poco::FastMutex::ScopedLock lock(mutex_);
+        Host &entry = hosts_[key];
+        if (!entry.idle.empty())
+        {
+            std::unique_ptr<Poco::Net::HTTPSClientSession> session(std::move(entry.idle.back()));
+            entry.idle.pop_back();
+            return Lease(*this, key, std::move(session), true);
+        }
+        tls = entry.tls;
+    }
+
+    // Connecting is left to the first request, outside the lock.
+    std::unique_ptr<Poco::Net::HTTPSClientSession> session(
+        tls ? new Poco::Net::HTTPSClientSession(host, port, context_, tls)
+            : new Poco::Net::HTTPSClientSession(host, port, context_));
+    session->setTimeout(timeout_);
+    session->setKeepAlive(true);
+    return Lease(*this, key, std::move(session), false);
+}
+
+Poco::Net::Session::Ptr SessionPool::tlsSession(const std::string &host, Poco::UInt16 port)
+{
+    Poco::FastMutex::ScopedLock lock(mutex_);
+    const auto it = hosts_.find(keyOf(host, port));
+    return it == hosts_.end() ? Poco::Net::Session::Ptr() : it->second.tls;
+}
+
+void SessionPool::setTlsSession(const std::string &host, Poco::UInt16 port, const Poco::Net::Session::Ptr &tls)
+{
+    if (tls)
+    {
+        Poco::FastMutex::ScopedLock lock(mutex_);
+        hosts_[keyOf(host, port)].tls = tls;
+    }
+}
+
+std::string SessionPool::keyOf(const std::string &host, Poco::UInt16 port)
+{
+    std::string key(host);
+    key += ':';
+    Poco::NumberFormatter::append(key, static_cast<unsigned>(port));
+    return key;
+}
+
+void SessionPool::release(const std::string &key, std::unique_ptr<Poco::Net::HTTPSClientSession> session)
+{
+    Poco::Net::Session::Ptr tls = session->sslSession();
+
+    Poco::FastMutex::ScopedLock lock(mutex_);
+    Host &entry = hosts_[key];
+    if (tls)
+    {
+        entry.tls = tls;
+    }
+    if (entry.idle.size() < maxIdle_)
+    {
+        entry.idle.push_back(std::move(session));
+    }
+}
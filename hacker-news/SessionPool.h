@@ -0,0 +1,98 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Package: Foundation
+#include <Poco/Timespan.h>
+
+// Package: HTTPSClient
+#include <Poco/Net/HTTPSClientSession.h>
+
+// Package: SSLCore
+#include <Poco/Net/Context.h>
+#include <Poco/Net/Session.h>
+
+// Package: Threading
+#include <Poco/Mutex.h>
+
+// Keep-alive HTTPS sessions, kept per host and port, so a request reuses a
+// connection an earlier one has finished with instead of paying for a new TCP
+// and TLS handshake.
+//
+// Every session shares one client Context with session caching on, and a new
+// connection to a host resumes the TLS session of the last one there, which
+// skips most of the handshake when a connection has to be replaced.
+class SessionPool
+{
+public:
+    // A session checked out of the pool. It goes back when the Lease is
+    // destroyed, unless discard() has said the connection can't be reused.
+    class Lease
+    {
+    public:
+        Lease(Lease &&other);
+        ~Lease();
+
+        Poco::Net::HTTPSClientSession &operator*() const { return *session_; }
+        Poco::Net::HTTPSClientSession *operator->() const { return session_.get(); }
+
+        // True if the session has already answered a request, in which case
+        // a failure may only mean the server closed it while it sat idle.
+        bool reused() const { return reused_; }
+
+        void discard() { session_.reset(); }
+
+    private:
+        friend class SessionPool;
+
+        Lease(SessionPool &pool, const std::string &key, std::unique_ptr<Poco::Net::HTTPSClientSession> session, bool reused);
+        Lease(const Lease &);
+        Lease &operator=(const Lease &);
+
+        SessionPool *pool_;
+        std::string key_;
+        std::unique_ptr<Poco::Net::HTTPSClientSession> session_;
+        bool reused_;
+    };
+
+    // Keeps up to `maxIdlePerHost` idle sessions for each host; `timeout`
+    // applies to every socket operation.
+    explicit SessionPool(const Poco::Timespan &timeout, std::size_t maxIdlePerHost = 16);
+    ~SessionPool();
+
+    // An idle session to host:port, or a new one.
+    Lease acquire(const std::string &host, Poco::UInt16 port);
+
+    const Poco::Net::Context::Ptr &context() const { return context_; }
+
+    // The TLS session to resume on a new connection to host:port, or null if
+    // there hasn't been one yet.
+    Poco::Net::Session::Ptr tlsSession(const std::string &host, Poco::UInt16 port);
+
+    // Records a TLS session established outside the pool, for later
+    // connections to resume.
+    void setTlsSession(const std::string &host, Poco::UInt16 port, const Poco::Net::Session::Ptr &tls);
+
+private:
+    SessionPool(const SessionPool &);
+    SessionPool &operator=(const SessionPool &);
+
+    struct Host
+    {
+        std::vector<std::unique_ptr<Poco::Net::HTTPSClientSession>> idle;
+        Poco::Net::Session::Ptr tls;
+    };
+
+    static std::string keyOf(const std::string &host, Poco::UInt16 port);
+
+    void release(const std::string &key, std::unique_ptr<Poco::Net::HTTPSClientSession> session);
+
+    Poco::Net::Context::Ptr context_;
+    const Poco::Timespan timeout_;
+    const std::size_t maxIdle_;
+    Poco::FastMutex mutex_;
+    std::map<std::string, Host> hosts_;
+};
@@ -0,0 +1,48 @@
+#include "VisitedSet.h"
+
+struct VisitedSet::Page
+{
+    Page()
+    {
+        for (auto &word : words)
+        {
+            word.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    std::atomic<Poco::UInt64> words[PAGE_BITS / 64];
+};
+
+VisitedSet::VisitedSet() : pages_(new std::atomic<Page *>[PAGES])
+{
+    for (std::size_t i = 0; i < PAGES; ++i)
+    {
+        pages_[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+VisitedSet::~VisitedSet()
+{
+    for (std::size_t i = 0; i < PAGES; ++i)
+    {
+        delete pages_[i].load();
+    }
+}
+
+bool VisitedSet::insert(unsigned id)
+{
+    std::atomic<Page *> &entry = pages_[id / PAGE_BITS];
+    Page *page = entry.load();
+    if (!page)
+    {
+        // Whoever installs theirs first wins; the rest throw theirs away.
+        std::unique_ptr<Page> allocated(new Page);
+        if (entry.compare_exchange_strong(page, allocated.get()))
+        {
+            page = allocated.release();
+        }
+    }
+
+    const Poco::UInt64 bit = static_cast<Poco::UInt64>(1) << (id % 64);
+    return (page->words[id % PAGE_BITS / 64].fetch_or(bit) & bit) == 0;
+}
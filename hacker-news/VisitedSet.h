@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+// Package: Core
+#include <Poco/Types.h>
+
+// Item IDs already seen, for deduplication across threads without a lock.
+//
+// A bitmap over the whole unsigned range, one bit an ID, split into pages of
+// 128K that are allocated only once an ID in them turns up. Items posted
+// around the same time have IDs close together, so the comments on a day's
+// stories fall in a few pages.
+class VisitedSet
+{
+public:
+    VisitedSet();
+    ~VisitedSet();
+
+    // Marks `id` as seen. Returns true if it hadn't been, for just one of any
+    // threads inserting it at once.
+    bool insert(unsigned id);
+
+    static const unsigned PAGE_BITS = 1u << 20;
+
+private:
+    VisitedSet(const VisitedSet &);
+    VisitedSet &operator=(const VisitedSet &);
+
+    struct Page;
+
+    // 2^32 IDs in pages of PAGE_BITS.
+    static const std::size_t PAGES = (static_cast<Poco::UInt64>(1) << 32) / PAGE_BITS;
+
+    std::unique_ptr<std::atomic<Page *>[]> pages_;
+};
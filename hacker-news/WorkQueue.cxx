@@ -0,0 +1,100 @@
+#include "WorkQueue.h"
+
+// Package: Core
+#include <Poco/Exception.h>
+
+struct WorkQueue::Segment
+{
+    Segment()
+    {
+        for (auto &item : items)
+        {
+            item.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    std::atomic<Poco::UInt64> items[SEGMENT_SIZE];
+};
+
+WorkQueue::WorkQueue()
+    : segments_(new std::atomic<Segment *>[CAPACITY / SEGMENT_SIZE]), head_(0), tail_(0)
+{
+    for (std::size_t i = 0; i < CAPACITY / SEGMENT_SIZE; ++i)
+    {
+        segments_[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+WorkQueue::~WorkQueue()
+{
+    for (std::size_t i = 0; i < CAPACITY / SEGMENT_SIZE; ++i)
+    {
+        delete segments_[i].load();
+    }
+}
+
+void WorkQueue::push(unsigned id, unsigned depth)
+{
+    // Reserved only below the capacity, so no slot is left that will never
+    // be filled.
+    std::size_t position = tail_.load();
+    do
+    {
+        if (position >= CAPACITY)
+        {
+            throw Poco::RangeException("Work queue is full");
+        }
+    } while (!tail_.compare_exchange_weak(position, position + 1));
+
+    slot(position).store(static_cast<Poco::UInt64>(depth) << 32 | id, std::memory_order_release);
+}
+
+bool WorkQueue::pop(Item &item, std::size_t &position)
+{
+    std::size_t head = head_.load();
+    while (head < tail_.load())
+    {
+        // Still being filled in by its push; it'll be ready next time.
+        const Poco::UInt64 value = slot(head).load(std::memory_order_acquire);
+        if (value == 0)
+        {
+            return false;
+        }
+        if (head_.compare_exchange_weak(head, head + 1))
+        {
+            item = unpack(value);
+            position = head;
+            return true;
+        }
+    }
+    return false;
+}
+
+WorkQueue::Item WorkQueue::at(std::size_t position) const
+{
+    return unpack(segments_[position / SEGMENT_SIZE].load()->items[position % SEGMENT_SIZE].load(std::memory_order_acquire));
+}
+
+std::atomic<Poco::UInt64> &WorkQueue::slot(std::size_t position)
+{
+    std::atomic<Segment *> &entry = segments_[position / SEGMENT_SIZE];
+    Segment *segment = entry.load();
+    if (!segment)
+    {
+        // Whoever installs theirs first wins; the rest throw theirs away.
+        std::unique_ptr<Segment> allocated(new Segment);
+        if (entry.compare_exchange_strong(segment, allocated.get()))
+        {
+            segment = allocated.release();
+        }
+    }
+    return segment->items[position % SEGMENT_SIZE];
+}
+
+WorkQueue::Item WorkQueue::unpack(Poco::UInt64 value)
+{
+    Item item;
+    item.id = static_cast<unsigned>(value);
+    item.depth = static_cast<unsigned>(value >> 32);
+    return item;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+// Package: Core
+#include <Poco/Types.h>
+
+// Item IDs waiting to be fetched, each with its depth in a crawl, shared by
+// every loop without a lock.
+//
+// An append-only log read through a cursor: push() reserves the next slot and
+// fills it in, and pop() claims the oldest filled slot by moving the cursor on
+// with a compare-and-swap. IDs come out in the order they went in, and a push
+// can come from any thread while others pop, as when a response leads to
+// more items. Slots live in segments allocated as the log grows and are only
+// freed with the queue, so a reader never finds one gone.
+//
+// IDs must be non-zero, since 0 marks a slot reserved but not yet filled.
+class WorkQueue
+{
+public:
+    struct Item
+    {
+        unsigned id = 0;
+        unsigned depth = 0; // how many links from where the work started
+    };
+
+    WorkQueue();
+    ~WorkQueue();
+
+    // Throws Poco::RangeException once the queue has had CAPACITY IDs.
+    void push(unsigned id, unsigned depth = 0);
+
+    // Takes the oldest item, and where it came in the order pushed. Returns
+    // false if there's none for now.
+    bool pop(Item &item, std::size_t &position);
+
+    // The item pushed at `position`, once its push has returned.
+    Item at(std::size_t position) const;
+
+    // True if every ID pushed so far has been popped.
+    bool empty() const { return head_.load() >= tail_.load(); }
+
+    // How many IDs have been pushed.
+    std::size_t size() const { return tail_.load(); }
+
+    static const std::size_t SEGMENT_SIZE = 4096;
+    static const std::size_t CAPACITY = SEGMENT_SIZE * 16384;
+
+private:
+    WorkQueue(const WorkQueue &);
+    WorkQueue &operator=(const WorkQueue &);
+
+    struct Segment;
+
+    // Allocates the slot's segment if no one has yet.
+    std::atomic<Poco::UInt64> &slot(std::size_t position);
+
+    // An item's slot holds its depth above its ID.
+    static Item unpack(Poco::UInt64 value);
+
+    std::unique_ptr<std::atomic<Segment *>[]> segments_;
+    std::atomic<std::size_t> head_; // next to pop
+    std::atomic<std::size_t> tail_; // next to push
+};
@@ -1,15 +1,17 @@
-// NOTE: Poco doesn't have async HTTP APIs.
+// NOTE: Poco doesn't have async HTTP APIs; AsyncClient is built on its
+// non-blocking sockets instead.
 
 // Package: Application
 #include <Poco/Util/Application.h>
 
 // Package: Core
-#include <Poco/SharedPtr.h>
+#include <Poco/NumberParser.h>
 
 // Package: Dynamic
 #include <Poco/Dynamic/Var.h>
 
 // Package: Foundation
+#include <Poco/FileStream.h>
 #include <Poco/Timespan.h>
 #include <Poco/URI.h>
 #include <Poco/StreamCopier.h>
@@ -29,59 +31,83 @@
 // Package: NetCore
 #include <Poco/Net/NetException.h>
 
+// Package: Options
+#include <Poco/Util/HelpFormatter.h>
+#include <Poco/Util/IntValidator.h>
+#include <Poco/Util/Option.h>
+#include <Poco/Util/OptionSet.h>
+
 // Package: SSLCore
-#include <Poco/Net/Context.h>
 #include <Poco/Net/SSLException.h>
 
 // Package: Threading
-#include <Poco/Runnable.h>
+#include <Poco/Mutex.h>
 #include <Poco/ScopedLock.h>
 #include <Poco/Thread.h>
-#include <Poco/ThreadPool.h>
 
-static std::string InvokeWebRequest(const std::string &uriString)
+#include <atomic>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+#include "AsyncClient.h"
+#include "SessionPool.h"
+#include "VisitedSet.h"
+#include "WorkQueue.h"
+
+static const std::string HOST{"hacker-news.firebaseio.com"};
+static const Poco::UInt16 PORT{443};
+
+// GETs `uriString` on a pooled keep-alive session.
+static std::string InvokeWebRequest(SessionPool &pool, const std::string &uriString)
 {
     const Poco::URI uri(uriString);
 
-    // sendRequest may show:
-    //
-    // WARNING: Certificate verification failed
-    // ----------------------------------------
-    // Issuer Name:  C=BE,O=GlobalSign nv-sa,OU=Root CA,CN=GlobalSign Root CA
-    // Subject Name: C=US,O=Google Trust Services LLC,CN=GTS Root R1
-    //
-    // The certificate yielded the error: unable to get local issuer certificate
-    //
-    // The error occurred in the certificate chain at position 2
-    // Accept the certificate (y,n)?
-    //
-    // Why?
-    // Due to intermediate certificates in its chain, so you will have to add all the intermediate CAs
-    //  presented to your trusted store to get this to work. If you don't want to perform certificate
-    // verification, use VERIFY_NONE by passing context object to HTTPSClientSession ctor.
-    const Poco::Net::Context::Ptr context = new Poco::Net::Context(
-        Poco::Net::Context::TLS_CLIENT_USE, // usage
-        "",                                 // caLocation
-        Poco::Net::Context::VERIFY_NONE     // verificationMode (default: VERIFY_RELAXED)
-    );
-    Poco::Net::HTTPSClientSession session(uri.getHost(), uri.getPort(), context);
-    session.setTimeout(Poco::Timespan(10 /*seconds*/, 0 /*microseconds*/));
-
-    Poco::Net::HTTPRequest request(Poco::Net::HTTPRequest::HTTP_GET, uri.getPath(), Poco::Net::HTTPMessage::HTTP_1_1);
-
-    (void)session.sendRequest(request);
-
-    Poco::Net::HTTPResponse response;
-    std::istream &is = session.receiveResponse(response);
-
-    // e.g. "200 OK"
-    // std::cout << response.getStatus() << " " << response.getReason() << std::endl;
-    // if (response.getStatus() == Poco::Net::HTTPResponse::HTTP_OK) ...
-
-    std::stringstream ss;
-    Poco::StreamCopier::copyStream(is, ss);
-
-    return ss.str();
+    for (;;)
+    {
+        SessionPool::Lease session = pool.acquire(uri.getHost(), uri.getPort());
+        try
+        {
+            Poco::Net::HTTPRequest request(Poco::Net::HTTPRequest::HTTP_GET, uri.getPathAndQuery(), Poco::Net::HTTPMessage::HTTP_1_1);
+            request.setKeepAlive(true);
+
+            (void)session->sendRequest(request);
+
+            Poco::Net::HTTPResponse response;
+            std::istream &is = session->receiveResponse(response);
+
+            // e.g. "200 OK"
+            // std::cout << response.getStatus() << " " << response.getReason() << std::endl;
+            // if (response.getStatus() == Poco::Net::HTTPResponse::HTTP_OK) ...
+
+            // The body has to be read to the end before the session can be
+            // reused.
+            std::stringstream ss;
+            Poco::StreamCopier::copyStream(is, ss);
+
+            if (!response.getKeepAlive())
+            {
+                session.discard();
+            }
+            return ss.str();
+        }
+        catch (const Poco::Net::NetException &)
+        {
+            session.discard();
+
+            // A reused session may just have been closed by the server while
+            // it sat idle; a GET can safely go again on a new connection.
+            if (!session.reused())
+            {
+                throw;
+            }
+        }
+        catch (...)
+        {
+            session.discard();
+            throw;
+        }
+    }
 }
 
 class IdCollection
@@ -98,7 +124,7 @@ public:
 
         Poco::JSON::Array::Ptr jsonArray = objects[0].extract<Poco::JSON::Array::Ptr>();
 
-        // Convert JSON array to ids stack
+        // Queued in rank order
         for (const auto &item : *jsonArray)
         {
             unsigned int id;
@@ -107,95 +133,414 @@ public:
         }
     }
 
-    // Synchronized access to ids. Returns false if no more items.
-    bool Next(unsigned int &id)
+    // Lock-free access to ids, in the order queued: stories by rank, then
+    // anything pushed. Returns false if no more items.
+    bool Next(WorkQueue::Item &item, std::size_t &position)
+    {
+        return ids_.pop(item, position);
+    }
+
+    void Push(unsigned int id, unsigned int depth)
+    {
+        ids_.push(id, depth);
+    }
+
+    WorkQueue::Item At(std::size_t position) const
+    {
+        return ids_.at(position);
+    }
+
+    std::size_t Size() const
+    {
+        return ids_.size();
+    }
+
+    bool Empty() const
+    {
+        return ids_.empty();
+    }
+
+private:
+    WorkQueue ids_;
+};
+
+// Prints each story's title as its item arrives, or in rank order.
+class StoryPrinter : public AsyncClient::Handler
+{
+public:
+    StoryPrinter(IdCollection &ids, bool ordered) : ids_(ids), ordered_(ordered) {}
+
+    bool next(AsyncClient::Request &request) override
+    {
+        WorkQueue::Item item;
+        std::size_t rank;
+        if (!ids_.Next(item, rank))
+        {
+            return false;
+        }
+        request.path = Poco::cat(std::string("/v0/item/"), std::to_string(item.id), std::string(".json"));
+        request.id = static_cast<unsigned>(rank); // the item is ids_.At(rank)
+        return true;
+    }
+
+    bool finished() const override
+    {
+        return ids_.Empty();
+    }
+
+    void handle(const AsyncClient::Request &request, const AsyncClient::Response &response) override
+    {
+        const unsigned int id{ids_.At(request.id).id};
+        if (!response.error.empty() || response.status != Poco::Net::HTTPResponse::HTTP_OK)
+        {
+            emit(request.id, true, Poco::cat(std::to_string(id), std::string(" : "), response.error.empty() ? std::to_string(response.status) : response.error));
+            return;
+        }
+
+        // {
+        //  "by":"janniks",
+        //  "descendants":297,
+        //  "id":35056379,
+        //   "kids":[35058025,35056380],
+        //   "score":557,
+        //   "time":1678202909,
+        //   "title":"Hardware microphone disconnect (2021)",
+        //    "type":"story",
+        //    "url":"https://support.apple.com/guide/security/hardware-microphone-disconnect-secbbd20b00b/web"
+        // }
+
+        // Every rank has to be emitted, or ordered output would stop there.
+        try
+        {
+            Poco::JSON::Parser parser;
+            Poco::Dynamic::Var objects = parser.parse(response.body);
+            if (objects.size() != 1)
+            {
+                emit(request.id, true, "Expecting one object from item");
+                return;
+            }
+
+            Poco::JSON::Object::Ptr object = objects[0].extract<Poco::JSON::Object::Ptr>();
+            const unsigned story_id{object->getValue<unsigned int>("id")};
+            const std::string story_title{object->getValue<std::string>("title")};
+
+            std::ostringstream line;
+            line << story_id << " : " << story_title << " (TID " << Poco::Thread::currentTid() << ")";
+            emit(request.id, false, line.str());
+        }
+        catch (const Poco::Exception &e)
+        {
+            emit(request.id, true, Poco::cat(std::to_string(id), std::string(" : "), e.displayText()));
+        }
+    }
+
+private:
+    struct Line
+    {
+        bool ready = false;
+        bool error = false;
+        std::string text;
+    };
+
+    // Writes a line now, or once every higher-ranked one has been written.
+    void emit(std::size_t rank, bool error, const std::string &text)
     {
-        bool success = false;
         Poco::Mutex::ScopedLock lock(mutex_);
-        if (!ids_.empty())
+        if (!ordered_)
+        {
+            (error ? std::cerr : std::cout) << text << std::endl;
+            return;
+        }
+
+        if (waiting_.size() <= rank)
         {
-            id = ids_.top();
-            ids_.pop();
-            success = true;
+            waiting_.resize(rank + 1);
+        }
+        waiting_[rank].ready = true;
+        waiting_[rank].error = error;
+        waiting_[rank].text = text;
+
+        for (; written_ < waiting_.size() && waiting_[written_].ready; ++written_)
+        {
+            Line &line = waiting_[written_];
+            (line.error ? std::cerr : std::cout) << line.text << std::endl;
+            std::string().swap(line.text);
         }
-        return success;
+    }
+
+    IdCollection &ids_;
+    const bool ordered_;
+    Poco::Mutex mutex_; // std::cout, std::cerr and the lines below
+    std::vector<Line> waiting_; // by rank
+    std::size_t written_ = 0;
+};
+
+// Writes JSON objects to a stream one to a line, from any thread.
+class JsonLinesSink
+{
+public:
+    JsonLinesSink(std::ostream &out) : out_(out) {}
+
+    void Write(const Poco::JSON::Object &object)
+    {
+        std::ostringstream line;
+        object.stringify(line);
+        line << '\n';
+
+        Poco::Mutex::ScopedLock lock(mutex_);
+        out_ << line.str();
+    }
+
+    void Flush()
+    {
+        Poco::Mutex::ScopedLock lock(mutex_);
+        out_.flush();
     }
 
 private:
+    std::ostream &out_;
     Poco::Mutex mutex_;
-    std::stack<unsigned int> ids_;
 };
 
-class Worker : public Poco::Runnable
+// Fetches every item in the stories' comment trees, breadth-first down to
+// `maxDepth` replies, and writes each to the sink as
+// {"id":..., "depth":..., "item":{...}}, or with "error" in place of "item".
+// Deleted and unknown items come back as null, and are written that way.
+class CommentCrawler : public AsyncClient::Handler
 {
 public:
-    Worker(IdCollection &ids) : ids_(ids) {}
+    CommentCrawler(IdCollection &ids, unsigned int maxDepth, JsonLinesSink &sink)
+        : ids_(ids), maxDepth_(maxDepth), sink_(sink), pending_(ids.Size()), written_(0), failed_(0)
+    {
+        for (std::size_t i = 0; i < ids.Size(); ++i)
+        {
+            visited_.insert(ids.At(i).id);
+        }
+    }
 
-    virtual void run()
+    bool next(AsyncClient::Request &request) override
     {
-        std::string ITEM_URL_BASE{"https://hacker-news.firebaseio.com/v0/item/"};
-        unsigned int id;
-        while (ids_.Next(id))
+        WorkQueue::Item item;
+        std::size_t position;
+        if (!ids_.Next(item, position))
         {
-            const std::string uri{Poco::cat(ITEM_URL_BASE, std::to_string(id), std::string(".json"))};
+            return false;
+        }
+        request.path = Poco::cat(std::string("/v0/item/"), std::to_string(item.id), std::string(".json"));
+        request.id = static_cast<unsigned>(position); // the item is ids_.At(position)
+        return true;
+    }
 
-            const std::string response{InvokeWebRequest(uri)};
+    // Every item is queued before its parent is done with, so none is left
+    // to come once nothing is pending.
+    bool finished() const override
+    {
+        return pending_.load() == 0;
+    }
 
-            // {
-            //  "by":"janniks",
-            //  "descendants":297,
-            //  "id":35056379,
-            //   "kids":[35058025,35056380],
-            //   "score":557,
-            //   "time":1678202909,
-            //   "title":"Hardware microphone disconnect (2021)",
-            //    "type":"story",
-            //    "url":"https://support.apple.com/guide/security/hardware-microphone-disconnect-secbbd20b00b/web"
-            // }
+    void handle(const AsyncClient::Request &request, const AsyncClient::Response &response) override
+    {
+        const WorkQueue::Item item{ids_.At(request.id)};
+        Poco::JSON::Object line;
+        line.set("id", item.id);
+        line.set("depth", item.depth);
+
+        try
+        {
+            if (!response.error.empty() || response.status != Poco::Net::HTTPResponse::HTTP_OK)
+            {
+                throw Poco::IOException(response.error.empty() ? std::to_string(response.status) : response.error);
+            }
 
             Poco::JSON::Parser parser;
-            Poco::Dynamic::Var objects = parser.parse(response);
-            if (objects.size() != 1)
+            Poco::Dynamic::Var objects = parser.parse(response.body);
+            if (objects.isEmpty())
             {
-                std::cerr << "Expecting one object from item" << std::endl;
+                // A deleted or unknown item: part of the thread, not a failure.
+                line.set("item", objects);
+                sink_.Write(line);
+                ++written_;
+                --pending_;
                 return;
             }
+            if (objects.size() != 1)
+            {
+                throw Poco::DataFormatException("Expecting one object from item");
+            }
 
             Poco::JSON::Object::Ptr object = objects[0].extract<Poco::JSON::Object::Ptr>();
-            const unsigned story_id{object->getValue<unsigned int>("id")};
-            const std::string story_title{object->getValue<std::string>("title")};
-            std::cout << story_id << " : " << story_title << " (TID " << Poco::Thread::currentTid() << ")" << std::endl;
+            line.set("item", object);
+            sink_.Write(line);
+            ++written_;
+
+            // The item still counts as pending, so the count can't reach
+            // zero before its kids are.
+            Poco::JSON::Array::Ptr kids = object->getArray("kids");
+            if (kids && item.depth < maxDepth_)
+            {
+                for (const auto &kid : *kids)
+                {
+                    unsigned int id;
+                    kid.convert(id);
+                    if (visited_.insert(id))
+                    {
+                        ids_.Push(id, item.depth + 1);
+                        ++pending_;
+                    }
+                }
+            }
+        }
+        catch (const Poco::Exception &e)
+        {
+            line.set("error", e.displayText());
+            sink_.Write(line);
+            ++failed_;
         }
+
+        --pending_;
     }
 
+    std::size_t Written() const { return written_.load(); }
+    std::size_t Failed() const { return failed_.load(); }
+
 private:
-    Poco::Mutex mutex;
     IdCollection &ids_;
+    const unsigned int maxDepth_;
+    JsonLinesSink &sink_;
+    VisitedSet visited_;
+    std::atomic<std::size_t> pending_; // queued or in flight
+    std::atomic<std::size_t> written_;
+    std::atomic<std::size_t> failed_;
 };
 
 class Application : public Poco::Util::Application
 {
-    int main(const std::vector<std::string> &arguments);
+    void defineOptions(Poco::Util::OptionSet &options) override
+    {
+        Poco::Util::Application::defineOptions(options);
+
+        options.addOption(
+            Poco::Util::Option("threads", "t", "poll connections on N threads (default 2)")
+                .argument("N")
+                .validator(new Poco::Util::IntValidator(1, 256)));
+        options.addOption(
+            Poco::Util::Option("concurrency", "c", "keep up to N requests in flight (default 64)")
+                .argument("N")
+                .validator(new Poco::Util::IntValidator(1, 4096)));
+        options.addOption(
+            Poco::Util::Option("pipeline", "p", "send up to N requests on a connection before the first is answered (default 1)")
+                .argument("N")
+                .validator(new Poco::Util::IntValidator(1, 64)));
+        options.addOption(
+            Poco::Util::Option("ordered", "o", "print stories in rank order rather than as they arrive"));
+        options.addOption(
+            Poco::Util::Option("crawl", "", "write every item in the stories' comment trees as lines of JSON"));
+        options.addOption(
+            Poco::Util::Option("depth", "d", "crawl replies down to N levels below the stories (default all)")
+                .argument("N")
+                .validator(new Poco::Util::IntValidator(0, 65535)));
+        options.addOption(
+            Poco::Util::Option("output", "O", "write the crawl to FILE rather than standard output")
+                .argument("FILE"));
+        options.addOption(
+            Poco::Util::Option("timeout", "", "give up on a request after N seconds (default 10)")
+                .argument("N")
+                .validator(new Poco::Util::IntValidator(1, 3600)));
+        options.addOption(Poco::Util::Option("help", "", "display this help and exit."));
+    }
+
+    void handleOption(const std::string &name, const std::string &value) override
+    {
+        Poco::Util::Application::handleOption(name, value);
+
+        if (name == "threads")
+        {
+            options_.threads = Poco::NumberParser::parseUnsigned(value);
+        }
+        else if (name == "concurrency")
+        {
+            options_.maxInFlight = Poco::NumberParser::parseUnsigned(value);
+        }
+        else if (name == "pipeline")
+        {
+            options_.pipeline = Poco::NumberParser::parseUnsigned(value);
+        }
+        else if (name == "ordered")
+        {
+            arg_ordered = true;
+        }
+        else if (name == "crawl")
+        {
+            arg_crawl = true;
+        }
+        else if (name == "depth")
+        {
+            arg_depth = Poco::NumberParser::parseUnsigned(value);
+        }
+        else if (name == "output")
+        {
+            arg_output = value;
+        }
+        else if (name == "timeout")
+        {
+            options_.timeout = Poco::Timespan(Poco::NumberParser::parseUnsigned(value), 0);
+        }
+        else if (name == "help")
+        {
+            arg_help = true;
+        }
+    }
+
+    int main(const std::vector<std::string> &arguments) override;
+
+    AsyncClient::Options options_;
+    bool arg_ordered = false;
+    bool arg_crawl = false;
+    unsigned int arg_depth = 65535;
+    std::string arg_output;
+    bool arg_help = false;
 };
 
 // Poco::Util::Application::main will catch exceptions.
 int Application::main(const std::vector<std::string> &arguments)
 {
+    if (arg_help || !arguments.empty())
+    {
+        Poco::Util::HelpFormatter formatter(options());
+        formatter.setCommand(commandName());
+        formatter.setUsage("[OPTION]...");
+        formatter.format(std::cout);
+        return arg_help ? EXIT_OK : EXIT_USAGE;
+    }
+
+    // Shared by every request, so connections stay open across items and
+    // new ones resume a TLS session instead of starting afresh.
+    SessionPool sessions(options_.timeout);
+
     // e.g. [35056379,35060298,35062007,35060438,35060273,35055121,35056548,35056094,35060972]
-    const std::string response{InvokeWebRequest("https://hacker-news.firebaseio.com/v0/topstories.json")};
+    const std::string response{InvokeWebRequest(sessions, Poco::cat(std::string("https://"), HOST, std::string("/v0/topstories.json")))};
     IdCollection collection(response);
 
-    // Start threads
-    std::vector<Poco::SharedPtr<Worker>> runnables;
-    for (unsigned i = 0; i < 8; ++i)
+    // A few threads keep every request in flight.
+    AsyncClient client(sessions, HOST, PORT, options_);
+    if (!arg_crawl)
+    {
+        StoryPrinter printer(collection, arg_ordered);
+        client.run(printer);
+        return 0;
+    }
+
+    std::unique_ptr<Poco::FileOutputStream> file;
+    if (!arg_output.empty())
     {
-        Poco::SharedPtr<Worker> worker(new Worker(collection));
-        runnables.push_back(worker);
-        Poco::ThreadPool::defaultPool().start(*worker);
+        file.reset(new Poco::FileOutputStream(arg_output));
     }
+    JsonLinesSink sink(file ? static_cast<std::ostream &>(*file) : std::cout);
+    CommentCrawler crawler(collection, arg_depth, sink);
+    client.run(crawler);
+    sink.Flush();
 
-    // Wait for workers to complete
-    Poco::ThreadPool::defaultPool().joinAll();
+    std::cerr << crawler.Written() << " items, " << crawler.Failed() << " failed" << std::endl;
 
     return 0;
 }
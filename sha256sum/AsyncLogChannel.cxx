@@ -0,0 +1,161 @@
+#include "AsyncLogChannel.h"
+
+// Package: Core
+#include <Poco/Exception.h>
+#include <Poco/NumberFormatter.h>
+
+namespace
+{
+    std::size_t RoundUpToPowerOfTwo(std::size_t n)
+    {
+        std::size_t power = 2;
+        while (power < n)
+        {
+            power <<= 1;
+        }
+        return power;
+    }
+}
+
+AsyncLogChannel::AsyncLogChannel(Poco::Channel::Ptr channel, std::size_t capacity)
+    : channel_(channel),
+      slots_(new Slot[RoundUpToPowerOfTwo(capacity)]),
+      mask_(RoundUpToPowerOfTwo(capacity) - 1),
+      tail_(0),
+      head_(0),
+      dropped_(0),
+      stop_(false),
+      running_(false),
+      thread_("log flusher")
+{
+    for (std::size_t i = 0; i <= mask_; ++i)
+    {
+        slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+AsyncLogChannel::~AsyncLogChannel()
+{
+    try
+    {
+        close();
+    }
+    catch (...)
+    {
+    }
+}
+
+void AsyncLogChannel::open()
+{
+    if (running_)
+    {
+        return;
+    }
+
+    channel_->open();
+    stop_ = false;
+    thread_.start(*this);
+    running_ = true;
+}
+
+void AsyncLogChannel::close()
+{
+    if (!running_)
+    {
+        return;
+    }
+
+    stop_ = true;
+    wake_.set();
+    thread_.join();
+    running_ = false;
+
+    channel_->close();
+}
+
+void AsyncLogChannel::log(const Poco::Message &msg)
+{
+    std::size_t position = tail_.load(std::memory_order_relaxed);
+    Slot *slot;
+    for (;;)
+    {
+        slot = &slots_[position & mask_];
+        const std::ptrdiff_t lap = static_cast<std::ptrdiff_t>(slot->sequence.load(std::memory_order_acquire) - position);
+        if (lap == 0)
+        {
+            if (tail_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (lap < 0)
+        {
+            // The flusher hasn't emptied this slot since the last lap: full.
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        else
+        {
+            position = tail_.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->message = msg;
+    slot->sequence.store(position + 1, std::memory_order_release);
+
+    if (position - head_.load(std::memory_order_relaxed) == (mask_ + 1) / 2)
+    {
+        wake_.set();
+    }
+}
+
+void AsyncLogChannel::run()
+{
+    while (!stop_)
+    {
+        wake_.tryWait(FLUSH_INTERVAL_MS);
+        drain();
+    }
+    drain();
+}
+
+// Writes out every published message. Messages claimed but not yet published
+// wait for the next round, which keeps them in order.
+void AsyncLogChannel::drain()
+{
+    std::size_t position = head_.load(std::memory_order_relaxed);
+    Poco::Message message;
+    for (;;)
+    {
+        Slot &slot = slots_[position & mask_];
+        if (slot.sequence.load(std::memory_order_acquire) != position + 1)
+        {
+            break;
+        }
+
+        message.swap(slot.message);
+        slot.sequence.store(position + mask_ + 1, std::memory_order_release);
+        head_.store(++position, std::memory_order_relaxed);
+
+        try
+        {
+            channel_->log(message);
+        }
+        catch (const Poco::Exception &)
+        {
+            // Nowhere left to report it.
+        }
+    }
+
+    const unsigned long dropped = dropped_.exchange(0, std::memory_order_relaxed);
+    if (dropped > 0)
+    {
+        try
+        {
+            channel_->log(Poco::Message("AsyncLogChannel", Poco::NumberFormatter::format(dropped) + " log messages dropped, ring full", Poco::Message::PRIO_WARNING));
+        }
+        catch (const Poco::Exception &)
+        {
+        }
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+// Package: Logging
+#include <Poco/Channel.h>
+#include <Poco/Message.h>
+
+// Package: Threading
+#include <Poco/Event.h>
+#include <Poco/Runnable.h>
+#include <Poco/Thread.h>
+
+// Hands messages to another channel from a background thread.
+//
+// log() copies the message into a fixed ring of slots and returns; it never
+// takes a lock or touches the file, so hashing threads don't wait on the log.
+// The ring is a bounded multi-producer queue: a producer claims a slot by
+// advancing the tail with a compare-and-swap, and publishes it through the
+// slot's sequence number. When the ring is full the message is dropped and
+// counted, and the flusher logs how many went missing once it catches up.
+//
+// The flusher drains the ring every FLUSH_INTERVAL_MS, or as soon as it's half
+// full. close() stops it after writing out whatever is left.
+class AsyncLogChannel : public Poco::Channel, private Poco::Runnable
+{
+public:
+    typedef Poco::AutoPtr<AsyncLogChannel> Ptr;
+
+    // `capacity` is rounded up to a power of two.
+    explicit AsyncLogChannel(Poco::Channel::Ptr channel, std::size_t capacity = 1024);
+
+    void open() override;
+    void close() override;
+    void log(const Poco::Message &msg) override;
+
+protected:
+    ~AsyncLogChannel() override;
+
+private:
+    AsyncLogChannel(const AsyncLogChannel &);
+    AsyncLogChannel &operator=(const AsyncLogChannel &);
+
+    static const long FLUSH_INTERVAL_MS = 200;
+
+    struct Slot
+    {
+        std::atomic<std::size_t> sequence;
+        Poco::Message message;
+    };
+
+    void run() override;
+    void drain();
+
+    Poco::Channel::Ptr channel_;
+    std::unique_ptr<Slot[]> slots_;
+    const std::size_t mask_;
+    std::atomic<std::size_t> tail_;
+    std::atomic<std::size_t> head_; // only the flusher moves it
+    std::atomic<unsigned long> dropped_;
+    std::atomic<bool> stop_;
+    bool running_;
+    Poco::Event wake_;
+    Poco::Thread thread_;
+};
@@ -0,0 +1,104 @@
+#include "ChunkedDigest.h"
+
+// Package: Filesystem
+#include <Poco/File.h>
+
+#include "FileDigest.h"
+#include "Sha256Backend.h"
+
+namespace
+{
+    const unsigned char LEAF_PREFIX = 0x00;
+    const unsigned char NODE_PREFIX = 0x01;
+}
+
+class ChunkedDigest::ChunkTask : public PoolTask
+{
+public:
+    ChunkTask(ChunkedDigest &owner, std::size_t index) : owner_(owner), index_(index) {}
+
+    void run() noexcept override
+    {
+        try
+        {
+            Sha256Engine engine(owner_.backend_);
+            DigestFileRange(owner_.pathName_, index_ * owner_.chunkSize_, owner_.chunkSize_, engine);
+            owner_.chunks_[index_] = engine.digest();
+        }
+        catch (...)
+        {
+            owner_.errors_[index_] = CaptureException();
+        }
+        owner_.tasks_.finish();
+    }
+
+private:
+    ChunkedDigest &owner_;
+    std::size_t index_;
+};
+
+ChunkedDigest::ChunkedDigest(Poco::NotificationQueue &queue, const Sha256Backend &backend, Poco::UInt64 chunkSize)
+    : backend_(backend), chunkSize_(chunkSize), tasks_(queue)
+{
+}
+
+void ChunkedDigest::compute(const std::string &pathName)
+{
+    pathName_ = pathName;
+    size_ = Poco::File(pathName).getSize();
+
+    // Every task writes only its own slot, so neither vector needs a lock.
+    const std::size_t count = static_cast<std::size_t>((size_ + chunkSize_ - 1) / chunkSize_);
+    chunks_.assign(count, Poco::DigestEngine::Digest());
+    errors_.assign(count, Poco::SharedPtr<Poco::Exception>());
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        tasks_.enqueue(new ChunkTask(*this, i));
+    }
+    tasks_.wait();
+
+    for (const Poco::SharedPtr<Poco::Exception> &error : errors_)
+    {
+        if (error)
+        {
+            error->rethrow();
+        }
+    }
+
+    root_ = merkleRoot(backend_, chunks_);
+}
+
+Poco::DigestEngine::Digest ChunkedDigest::merkleRoot(const Sha256Backend &backend, const std::vector<Poco::DigestEngine::Digest> &chunks)
+{
+    if (chunks.empty())
+    {
+        Sha256Engine engine(backend);
+        return engine.digest();
+    }
+    return subtree(backend, chunks, 0, chunks.size());
+}
+
+Poco::DigestEngine::Digest ChunkedDigest::subtree(const Sha256Backend &backend, const std::vector<Poco::DigestEngine::Digest> &chunks, std::size_t first, std::size_t count)
+{
+    Sha256Engine engine(backend);
+    if (count == 1)
+    {
+        engine.update(&LEAF_PREFIX, 1);
+        engine.update(chunks[first].data(), chunks[first].size());
+        return engine.digest();
+    }
+
+    std::size_t left = 1;
+    while (left * 2 < count)
+    {
+        left *= 2;
+    }
+
+    const Poco::DigestEngine::Digest l(subtree(backend, chunks, first, left));
+    const Poco::DigestEngine::Digest r(subtree(backend, chunks, first + left, count - left));
+    engine.update(&NODE_PREFIX, 1);
+    engine.update(l.data(), l.size());
+    engine.update(r.data(), r.size());
+    return engine.digest();
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Package: Core
+#include <Poco/SharedPtr.h>
+#include <Poco/Types.h>
+
+// Package: Crypt
+#include <Poco/DigestEngine.h>
+
+// Package: Threading
+#include <Poco/NotificationQueue.h>
+
+#include "PoolTask.h"
+
+class Sha256Backend;
+
+// A SHA-256 Merkle tree over fixed-size chunks of a file, so a single large
+// file can be hashed on every worker instead of one.
+//
+// Each chunk's plain SHA-256 is computed by its own PoolTask. The tree is put
+// together the way RFC 6962 does it: a leaf is SHA-256(0x00 || chunk digest),
+// an inner node SHA-256(0x01 || left || right), and the left subtree covers the
+// largest power of two of chunks that leaves some for the right. An empty file
+// has the SHA-256 of nothing as its root. Since chunk digests are plain
+// SHA-256, any one range can be checked on its own, with any tool.
+class ChunkedDigest
+{
+public:
+    // chunkSize must not be zero.
+    ChunkedDigest(Poco::NotificationQueue &queue, const Sha256Backend &backend, Poco::UInt64 chunkSize);
+
+    // Hashes a file, with the calling thread helping the pool. Throws the
+    // first error any chunk ran into.
+    void compute(const std::string &pathName);
+
+    const Poco::DigestEngine::Digest &root() const { return root_; }
+    const std::vector<Poco::DigestEngine::Digest> &chunks() const { return chunks_; }
+    Poco::UInt64 chunkSize() const { return chunkSize_; }
+    Poco::UInt64 size() const { return size_; }
+
+    static Poco::DigestEngine::Digest merkleRoot(const Sha256Backend &backend, const std::vector<Poco::DigestEngine::Digest> &chunks);
+
+private:
+    ChunkedDigest(const ChunkedDigest &);
+    ChunkedDigest &operator=(const ChunkedDigest &);
+
+    class ChunkTask;
+
+    static Poco::DigestEngine::Digest subtree(const Sha256Backend &backend, const std::vector<Poco::DigestEngine::Digest> &chunks, std::size_t first, std::size_t count);
+
+    const Sha256Backend &backend_;
+    const Poco::UInt64 chunkSize_;
+    TaskGroup tasks_;
+
+    std::string pathName_;
+    Poco::UInt64 size_ = 0;
+    std::vector<Poco::DigestEngine::Digest> chunks_;
+    std::vector<Poco::SharedPtr<Poco::Exception>> errors_;
+    Poco::DigestEngine::Digest root_;
+};
@@ -0,0 +1,412 @@
+#include "DigestCache.h"
+
+#include <cstring>
+#include <vector>
+
+// Package: Core
+#include <Poco/Foundation.h>
+
+// Package: DateTime
+#include <Poco/Timestamp.h>
+
+#if defined(POCO_OS_FAMILY_UNIX)
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    const char MAGIC[8] = {'S', 'H', 'A', '2', '5', '6', 'C', 'C'};
+    const Poco::UInt32 VERSION = 1;
+    const std::size_t DIGEST_SIZE = 32;
+
+    // 4096 entries is about 300 KiB; the table doubles past 70% load.
+    const Poco::UInt64 INITIAL_CAPACITY = 4096;
+
+    // Don't trust an mtime this close to the start of the run.
+    const Poco::Int64 RACY_WINDOW_NS = 2 * 1000 * 1000 * 1000LL;
+
+    inline Poco::UInt64 Finalize(Poco::UInt64 h)
+    {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    inline Poco::UInt64 Combine(Poco::UInt64 h, Poco::UInt64 value)
+    {
+        return Finalize(h ^ (value + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2)));
+    }
+
+#if defined(POCO_OS_FAMILY_UNIX)
+    bool KeyFromStat(const struct stat &st, DigestCache::Key &key)
+    {
+        if (!S_ISREG(st.st_mode))
+        {
+            return false;
+        }
+
+        key.device = static_cast<Poco::UInt64>(st.st_dev);
+        key.inode = static_cast<Poco::UInt64>(st.st_ino);
+        key.size = static_cast<Poco::UInt64>(st.st_size);
+#if defined(__APPLE__)
+        key.mtimeNs = static_cast<Poco::Int64>(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+        key.mtimeNs = static_cast<Poco::Int64>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+        return true;
+    }
+#endif
+}
+
+struct DigestCache::Header
+{
+    char magic[8];
+    Poco::UInt32 version;
+    Poco::UInt32 entrySize;
+    Poco::UInt64 capacity;
+    Poco::UInt64 count;
+    unsigned char reserved[32];
+};
+
+// A slot is free while device and inode are both zero. The checksum covers
+// everything else and is written last.
+struct DigestCache::Entry
+{
+    Poco::UInt64 device;
+    Poco::UInt64 inode;
+    Poco::UInt64 size;
+    Poco::Int64 mtimeNs;
+    unsigned char digest[DIGEST_SIZE];
+    Poco::UInt64 checksum;
+
+    bool isFree() const { return device == 0 && inode == 0; }
+
+    Poco::UInt64 computeChecksum() const
+    {
+        Poco::UInt64 h = Combine(Combine(Combine(Combine(0, device), inode), size), static_cast<Poco::UInt64>(mtimeNs));
+        for (unsigned i = 0; i < sizeof(digest); i += 8)
+        {
+            Poco::UInt64 word;
+            std::memcpy(&word, digest + i, sizeof(word));
+            h = Combine(h, word);
+        }
+        // Never zero, so a zeroed slot can't pass.
+        return h | 1;
+    }
+};
+
+bool DigestCache::Key::operator==(const Key &other) const
+{
+    return device == other.device && inode == other.inode && size == other.size && mtimeNs == other.mtimeNs;
+}
+
+DigestCache::DigestCache() : fd_(-1), data_(nullptr), mappedSize_(0), openedNs_(0)
+{
+}
+
+DigestCache::~DigestCache()
+{
+    close();
+}
+
+bool DigestCache::isOpen() const
+{
+    // grow() remaps, or on failure closes, under the lock.
+    Poco::FastMutex::ScopedLock lock(mutex_);
+    return data_ != nullptr;
+}
+
+#if defined(POCO_OS_FAMILY_UNIX)
+
+bool DigestCache::open(const std::string &pathName)
+{
+    Poco::FastMutex::ScopedLock lock(mutex_);
+
+    int flags = O_RDWR | O_CREAT;
+#if defined(O_CLOEXEC)
+    flags |= O_CLOEXEC;
+#endif
+    fd_ = ::open(pathName.c_str(), flags, 0644);
+    if (fd_ < 0)
+    {
+        return false;
+    }
+
+    // Another run already owns the cache; this one does without.
+    if (::flock(fd_, LOCK_EX | LOCK_NB) != 0)
+    {
+        ::close(fd_);
+        fd_ = -1;
+        return false;
+    }
+
+    struct stat st;
+    Header header;
+    bool valid = ::fstat(fd_, &st) == 0 &&
+                 static_cast<std::size_t>(st.st_size) >= sizeof(Header) &&
+                 ::pread(fd_, &header, sizeof(header), 0) == static_cast<ssize_t>(sizeof(header)) &&
+                 std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 &&
+                 header.version == VERSION &&
+                 header.entrySize == sizeof(Entry) &&
+                 header.capacity >= INITIAL_CAPACITY &&
+                 (header.capacity & (header.capacity - 1)) == 0 &&
+                 static_cast<Poco::UInt64>(st.st_size) >= sizeof(Header) + header.capacity * sizeof(Entry);
+
+    if (valid)
+    {
+        valid = map(header.capacity);
+    }
+    else
+    {
+        // New, foreign or from another version: start over.
+        if (::ftruncate(fd_, 0) == 0 && map(INITIAL_CAPACITY))
+        {
+            Header *h = static_cast<Header *>(data_);
+            std::memset(h, 0, sizeof(Header));
+            std::memcpy(h->magic, MAGIC, sizeof(MAGIC));
+            h->version = VERSION;
+            h->entrySize = sizeof(Entry);
+            h->capacity = INITIAL_CAPACITY;
+            valid = true;
+        }
+    }
+
+    if (!valid)
+    {
+        unmap();
+        ::close(fd_);
+        fd_ = -1;
+        return false;
+    }
+
+    openedNs_ = Poco::Timestamp().epochMicroseconds() * 1000;
+    return true;
+}
+
+void DigestCache::close()
+{
+    Poco::FastMutex::ScopedLock lock(mutex_);
+
+    unmap();
+    if (fd_ >= 0)
+    {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+bool DigestCache::keyFor(const std::string &pathName, Key &key)
+{
+    struct stat st;
+    return ::stat(pathName.c_str(), &st) == 0 && KeyFromStat(st, key);
+}
+
+bool DigestCache::keyFor(int fd, Key &key)
+{
+    struct stat st;
+    return ::fstat(fd, &st) == 0 && KeyFromStat(st, key);
+}
+
+bool DigestCache::lookup(const Key &key, Poco::DigestEngine::Digest &digest)
+{
+    Poco::FastMutex::ScopedLock lock(mutex_);
+
+    if (!data_)
+    {
+        return false;
+    }
+
+    const Entry *entry = find(key);
+    if (entry->isFree() || entry->size != key.size || entry->mtimeNs != key.mtimeNs ||
+        entry->checksum != entry->computeChecksum())
+    {
+        return false;
+    }
+
+    digest.assign(entry->digest, entry->digest + sizeof(entry->digest));
+    return true;
+}
+
+void DigestCache::store(const Key &key, const Poco::DigestEngine::Digest &digest)
+{
+    if (digest.size() != DIGEST_SIZE || key.mtimeNs > openedNs_ - RACY_WINDOW_NS)
+    {
+        return;
+    }
+
+    Poco::FastMutex::ScopedLock lock(mutex_);
+
+    if (!data_)
+    {
+        return;
+    }
+
+    Entry *entry = find(key);
+    if (entry->isFree())
+    {
+        Header *header = static_cast<Header *>(data_);
+        if ((header->count + 1) * 10 > header->capacity * 7)
+        {
+            grow();
+            if (!data_)
+            {
+                return;
+            }
+            header = static_cast<Header *>(data_);
+            entry = find(key);
+        }
+        ++header->count;
+    }
+
+    entry->checksum = 0;
+    entry->device = key.device;
+    entry->inode = key.inode;
+    entry->size = key.size;
+    entry->mtimeNs = key.mtimeNs;
+    std::memcpy(entry->digest, digest.data(), sizeof(entry->digest));
+    entry->checksum = entry->computeChecksum();
+}
+
+bool DigestCache::map(Poco::UInt64 capacity)
+{
+    const std::size_t size = static_cast<std::size_t>(sizeof(Header) + capacity * sizeof(Entry));
+
+    struct stat st;
+    if (::fstat(fd_, &st) != 0 || (static_cast<std::size_t>(st.st_size) < size && ::ftruncate(fd_, static_cast<off_t>(size)) != 0))
+    {
+        return false;
+    }
+
+    void *data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+
+    data_ = data;
+    mappedSize_ = size;
+    return true;
+}
+
+void DigestCache::unmap()
+{
+    if (data_)
+    {
+        ::munmap(data_, mappedSize_);
+        data_ = nullptr;
+        mappedSize_ = 0;
+    }
+}
+
+// Doubles the table and rehashes every entry. Called with mutex_ held; on
+// failure the cache is left closed.
+void DigestCache::grow()
+{
+    const Header *header = static_cast<const Header *>(data_);
+    const Entry *entries = reinterpret_cast<const Entry *>(header + 1);
+    const Poco::UInt64 capacity = header->capacity;
+
+    std::vector<Entry> live;
+    live.reserve(static_cast<std::size_t>(header->count));
+    for (Poco::UInt64 i = 0; i < capacity; ++i)
+    {
+        if (!entries[i].isFree())
+        {
+            live.push_back(entries[i]);
+        }
+    }
+
+    Header saved(*header);
+    unmap();
+    if (!map(capacity * 2))
+    {
+        return;
+    }
+
+    Header *grown = static_cast<Header *>(data_);
+    *grown = saved;
+    grown->capacity = capacity * 2;
+    grown->count = live.size();
+    std::memset(static_cast<void *>(grown + 1), 0, static_cast<std::size_t>(grown->capacity * sizeof(Entry)));
+
+    for (const Entry &entry : live)
+    {
+        Key key;
+        key.device = entry.device;
+        key.inode = entry.inode;
+        *find(key) = entry;
+    }
+}
+
+// The slot holding key's file, or the free slot where it would go. Size and
+// mtime don't take part: a changed file reuses its slot.
+DigestCache::Entry *DigestCache::find(const Key &key) const
+{
+    Header *header = static_cast<Header *>(data_);
+    Entry *entries = reinterpret_cast<Entry *>(header + 1);
+    const Poco::UInt64 mask = header->capacity - 1;
+
+    Poco::UInt64 index = Combine(Finalize(key.device), key.inode) & mask;
+    for (;;)
+    {
+        Entry *entry = &entries[index];
+        if (entry->isFree() || (entry->device == key.device && entry->inode == key.inode))
+        {
+            return entry;
+        }
+        index = (index + 1) & mask;
+    }
+}
+
+#else
+
+bool DigestCache::open(const std::string &)
+{
+    return false;
+}
+
+void DigestCache::close()
+{
+}
+
+bool DigestCache::keyFor(const std::string &, Key &)
+{
+    return false;
+}
+
+bool DigestCache::lookup(const Key &, Poco::DigestEngine::Digest &)
+{
+    return false;
+}
+
+void DigestCache::store(const Key &, const Poco::DigestEngine::Digest &)
+{
+}
+
+bool DigestCache::map(Poco::UInt64)
+{
+    return false;
+}
+
+void DigestCache::unmap()
+{
+}
+
+void DigestCache::grow()
+{
+}
+
+DigestCache::Entry *DigestCache::find(const Key &) const
+{
+    return nullptr;
+}
+
+#endif
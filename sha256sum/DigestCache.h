@@ -0,0 +1,71 @@
+#pragma once
+
+#include <string>
+
+// Package: Core
+#include <Poco/Foundation.h>
+#include <Poco/Mutex.h>
+#include <Poco/Types.h>
+
+// Package: Crypt
+#include <Poco/DigestEngine.h>
+
+// Remembers the SHA-256 of files by (device, inode, size, mtime) so unchanged
+// files don't have to be read again.
+//
+// The cache file is an open-addressing hash table that is memory-mapped as is:
+// opening it costs nothing beyond the mapping and a lookup is one short probe
+// sequence. Entries carry a checksum, so a torn write reads as a miss rather
+// than a wrong digest. One process owns the file at a time; a second one runs
+// without the cache. Only implemented on Unix; open() fails elsewhere.
+class DigestCache
+{
+public:
+    struct Key
+    {
+        Poco::UInt64 device = 0;
+        Poco::UInt64 inode = 0;
+        Poco::UInt64 size = 0;
+        Poco::Int64 mtimeNs = 0;
+
+        bool operator==(const Key &other) const;
+    };
+
+    DigestCache();
+    ~DigestCache();
+
+    // Opens, or creates, the cache at pathName. Returns false if it can't be used.
+    bool open(const std::string &pathName);
+    void close();
+    bool isOpen() const;
+
+    // Identifies a file. Returns false for anything but a regular file.
+    static bool keyFor(const std::string &pathName, Key &key);
+#if defined(POCO_OS_FAMILY_UNIX)
+    static bool keyFor(int fd, Key &key);
+#endif
+
+    bool lookup(const Key &key, Poco::DigestEngine::Digest &digest);
+
+    // Files modified in the last couple of seconds aren't stored, since a
+    // further change could land within the same mtime tick and go unnoticed.
+    void store(const Key &key, const Poco::DigestEngine::Digest &digest);
+
+private:
+    DigestCache(const DigestCache &);
+    DigestCache &operator=(const DigestCache &);
+
+    struct Header;
+    struct Entry;
+
+    bool map(Poco::UInt64 capacity);
+    void unmap();
+    void grow();
+    Entry *find(const Key &key) const;
+
+    mutable Poco::FastMutex mutex_;
+    int fd_;
+    void *data_;
+    std::size_t mappedSize_;
+    Poco::Int64 openedNs_;
+};
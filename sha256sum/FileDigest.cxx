@@ -0,0 +1,221 @@
+#include "FileDigest.h"
+
+#include <algorithm>
+
+// Package: Core
+#include <Poco/Exception.h>
+#include <Poco/Foundation.h>
+
+#if defined(POCO_OS_FAMILY_UNIX)
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+// Package: Filesystem
+#include <Poco/File.h>
+
+// Package: Streams
+#include <Poco/FileStream.h>
+#include <Poco/StreamCopier.h>
+#include <vector>
+#endif
+
+namespace
+{
+    // Large enough that the syscall cost disappears against hashing time.
+    const std::size_t READ_BUFFER_SIZE = 1024 * 1024;
+
+#if defined(POCO_OS_FAMILY_UNIX)
+    const std::size_t READ_BUFFER_ALIGNMENT = 4096;
+
+    int OpenReadOnly(const std::string &pathName)
+    {
+        return OpenFileAt(AT_FDCWD, pathName);
+    }
+#endif
+}
+
+void DigestFile(const std::string &pathName, Poco::DigestEngine &engine, const FileReader &reader)
+{
+#if defined(POCO_OS_FAMILY_UNIX)
+    FileDescriptor file(OpenReadOnly(pathName));
+    DigestDescriptor(file.get(), pathName, engine, reader);
+#else
+    (void)reader;
+    Poco::FileInputStream stream(pathName, std::ios::in | std::ios::binary);
+    std::vector<char> buffer(READ_BUFFER_SIZE);
+    while (stream.good())
+    {
+        stream.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        const std::streamsize n = stream.gcount();
+        if (n > 0)
+        {
+            engine.update(buffer.data(), static_cast<std::size_t>(n));
+        }
+    }
+    if (stream.bad())
+    {
+        throw Poco::ReadFileException(pathName);
+    }
+#endif
+}
+
+void DigestFileRange(const std::string &pathName, Poco::UInt64 offset, Poco::UInt64 length, Poco::DigestEngine &engine)
+{
+#if defined(POCO_OS_FAMILY_UNIX)
+    FileDescriptor file(OpenReadOnly(pathName));
+
+    void *buffer = nullptr;
+    if (::posix_memalign(&buffer, READ_BUFFER_ALIGNMENT, READ_BUFFER_SIZE) != 0)
+    {
+        throw Poco::OutOfMemoryException(pathName);
+    }
+
+    while (length > 0)
+    {
+        const std::size_t wanted = static_cast<std::size_t>(std::min<Poco::UInt64>(length, READ_BUFFER_SIZE));
+        const ssize_t n = ::pread(file.get(), buffer, wanted, static_cast<off_t>(offset));
+        if (n > 0)
+        {
+            engine.update(buffer, static_cast<std::size_t>(n));
+            offset += static_cast<Poco::UInt64>(n);
+            length -= static_cast<Poco::UInt64>(n);
+        }
+        else if (n == 0)
+        {
+            break;
+        }
+        else if (errno != EINTR)
+        {
+            const int error = errno;
+            std::free(buffer);
+            throw Poco::ReadFileException(pathName, error);
+        }
+    }
+
+    std::free(buffer);
+#else
+    Poco::FileInputStream stream(pathName, std::ios::in | std::ios::binary);
+    stream.seekg(static_cast<std::streamoff>(offset));
+    std::vector<char> buffer(READ_BUFFER_SIZE);
+    while (length > 0 && stream.good())
+    {
+        stream.read(buffer.data(), static_cast<std::streamsize>(std::min<Poco::UInt64>(length, buffer.size())));
+        const std::streamsize n = stream.gcount();
+        if (n > 0)
+        {
+            engine.update(buffer.data(), static_cast<std::size_t>(n));
+            length -= static_cast<Poco::UInt64>(n);
+        }
+    }
+    if (stream.bad())
+    {
+        throw Poco::ReadFileException(pathName);
+    }
+#endif
+}
+
+bool ReadSmallFile(const std::string &pathName, std::size_t limit, std::string &contents)
+{
+#if defined(POCO_OS_FAMILY_UNIX)
+    FileDescriptor file(OpenReadOnly(pathName));
+    return ReadSmallDescriptor(file.get(), pathName, limit, contents);
+#else
+    Poco::File file(pathName);
+    if (!file.isFile() || file.getSize() > limit)
+    {
+        return false;
+    }
+
+    Poco::FileInputStream stream(pathName, std::ios::in | std::ios::binary);
+    contents.clear();
+    Poco::StreamCopier::copyToString(stream, contents);
+    if (stream.bad())
+    {
+        throw Poco::ReadFileException(pathName);
+    }
+    return true;
+#endif
+}
+
+#if defined(POCO_OS_FAMILY_UNIX)
+FileDescriptor::~FileDescriptor()
+{
+    if (fd_ >= 0)
+    {
+        ::close(fd_);
+    }
+}
+
+void ThrowFileError(const std::string &pathName, int error)
+{
+    switch (error)
+    {
+    case ENOENT:
+    case ENOTDIR:
+        throw Poco::FileNotFoundException(pathName, std::strerror(error), error);
+    case EACCES:
+    case EPERM:
+        throw Poco::FileAccessDeniedException(pathName, std::strerror(error), error);
+    default:
+        throw Poco::OpenFileException(pathName, std::strerror(error), error);
+    }
+}
+
+int OpenFileAt(int directory, const std::string &name)
+{
+    int flags = O_RDONLY;
+#if defined(O_CLOEXEC)
+    flags |= O_CLOEXEC;
+#endif
+    const int fd = ::openat(directory, name.c_str(), flags);
+    if (fd < 0)
+    {
+        ThrowFileError(name, errno);
+    }
+    return fd;
+}
+
+void DigestDescriptor(int fd, const std::string &pathName, Poco::DigestEngine &engine, const FileReader &reader)
+{
+    reader.digest(fd, pathName, engine);
+}
+
+bool ReadSmallDescriptor(int fd, const std::string &pathName, std::size_t limit, std::string &contents)
+{
+    struct stat st;
+    if (::fstat(fd, &st) != 0)
+    {
+        ThrowFileError(pathName, errno);
+    }
+    if (!S_ISREG(st.st_mode) || static_cast<Poco::UInt64>(st.st_size) > limit)
+    {
+        return false;
+    }
+
+    contents.resize(static_cast<std::size_t>(st.st_size));
+    std::size_t size = 0;
+    while (size < contents.size())
+    {
+        const ssize_t n = ::read(fd, &contents[size], contents.size() - size);
+        if (n > 0)
+        {
+            size += static_cast<std::size_t>(n);
+        }
+        else if (n == 0)
+        {
+            break;
+        }
+        else if (errno != EINTR)
+        {
+            throw Poco::ReadFileException(pathName, errno);
+        }
+    }
+    // A file that shrank since fstat() is hashed as it is now.
+    contents.resize(size);
+    return true;
+}
+#endif
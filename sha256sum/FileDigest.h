@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string>
+
+// Package: Core
+#include <Poco/Foundation.h>
+#include <Poco/Types.h>
+
+// Package: Crypt
+#include <Poco/DigestEngine.h>
+
+#include "FileReader.h"
+
+// Feeds the contents of a file into a digest engine, read the way `reader`
+// reads. Errors are reported with the same Poco file exceptions
+// FileInputStream uses.
+void DigestFile(const std::string &pathName, Poco::DigestEngine &engine, const FileReader &reader);
+
+// Reads a regular file of at most `limit` bytes into memory. Returns false,
+// leaving `contents` unspecified, if the file is larger or not a regular file.
+bool ReadSmallFile(const std::string &pathName, std::size_t limit, std::string &contents);
+
+// Feeds `length` bytes of a file starting at `offset` into a digest engine,
+// or up to the end of the file if it's shorter. Safe to call for different
+// ranges of the same file from several threads at once.
+void DigestFileRange(const std::string &pathName, Poco::UInt64 offset, Poco::UInt64 length, Poco::DigestEngine &engine);
+
+#if defined(POCO_OS_FAMILY_UNIX)
+// Closes a file descriptor when it goes out of scope.
+class FileDescriptor
+{
+public:
+    explicit FileDescriptor(int fd) : fd_(fd) {}
+    ~FileDescriptor();
+
+    int get() const { return fd_; }
+
+private:
+    FileDescriptor(const FileDescriptor &);
+    FileDescriptor &operator=(const FileDescriptor &);
+
+    int fd_;
+};
+
+// Throws the Poco file exception for an errno from opening `pathName`, with
+// the system's message for it.
+void ThrowFileError(const std::string &pathName, int error);
+
+// Descriptor-based variants for callers that open files themselves, e.g. relative
+// to a directory with openat(). `pathName` only appears in error messages.
+int OpenFileAt(int directory, const std::string &name);
+void DigestDescriptor(int fd, const std::string &pathName, Poco::DigestEngine &engine, const FileReader &reader);
+bool ReadSmallDescriptor(int fd, const std::string &pathName, std::size_t limit, std::string &contents);
+#endif
@@ -0,0 +1,615 @@
+#include "FileReader.h"
+
+#include <cstdlib>
+
+// Package: Core
+#include <Poco/Exception.h>
+
+#if defined(POCO_OS_FAMILY_UNIX)
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Package: Threading
+#include <Poco/Runnable.h>
+#include <Poco/Semaphore.h>
+#include <Poco/Thread.h>
+#endif
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define SHA256SUM_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+#endif
+
+namespace
+{
+#if defined(POCO_OS_FAMILY_UNIX)
+    // Large enough that the syscall cost disappears against hashing time.
+    const std::size_t READ_BUFFER_SIZE = 1024 * 1024;
+    const std::size_t READ_BUFFER_ALIGNMENT = 4096;
+
+    // Below this, a couple of read() calls are cheaper than setting up a mapping.
+    const off_t MAP_THRESHOLD = 256 * 1024;
+
+    // Reads kept in flight by the asynchronous readers. Below the threshold
+    // there's too little to overlap to be worth the setup.
+    const unsigned READ_DEPTH = 4;
+    const off_t READ_AHEAD_THRESHOLD = 2 * READ_BUFFER_SIZE;
+
+    class AlignedBuffer
+    {
+    public:
+        explicit AlignedBuffer(std::size_t size) : data_(nullptr)
+        {
+            if (::posix_memalign(&data_, READ_BUFFER_ALIGNMENT, size) != 0)
+            {
+                throw Poco::OutOfMemoryException();
+            }
+        }
+        ~AlignedBuffer() { std::free(data_); }
+
+        unsigned char *get() const { return static_cast<unsigned char *>(data_); }
+
+    private:
+        AlignedBuffer(const AlignedBuffer &);
+        AlignedBuffer &operator=(const AlignedBuffer &);
+
+        void *data_;
+    };
+
+    bool IsLargeRegularFile(int fd, off_t threshold, off_t &size)
+    {
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size < threshold)
+        {
+            return false;
+        }
+        size = st.st_size;
+        return true;
+    }
+
+    class ReadReader : public FileReader
+    {
+    public:
+        const char *name() const override { return "read"; }
+
+        void digest(int fd, const std::string &pathName, Poco::DigestEngine &engine) const override
+        {
+            AlignedBuffer buffer(READ_BUFFER_SIZE);
+            for (;;)
+            {
+                const ssize_t n = ::read(fd, buffer.get(), READ_BUFFER_SIZE);
+                if (n > 0)
+                {
+                    engine.update(buffer.get(), static_cast<std::size_t>(n));
+                }
+                else if (n == 0)
+                {
+                    break;
+                }
+                else if (errno != EINTR)
+                {
+                    throw Poco::ReadFileException(pathName, errno);
+                }
+            }
+        }
+    };
+
+    const ReadReader readReader;
+
+    class MmapReader : public FileReader
+    {
+    public:
+        const char *name() const override { return "mmap"; }
+
+        // A file truncated by someone else while mapped raises SIGBUS; that's
+        // the same trade-off every mmap-based tool makes for skipping the copy.
+        void digest(int fd, const std::string &pathName, Poco::DigestEngine &engine) const override
+        {
+            off_t size = 0;
+            const off_t position = ::lseek(fd, 0, SEEK_CUR);
+            if (position == 0 && IsLargeRegularFile(fd, MAP_THRESHOLD, size))
+            {
+                void *data = ::mmap(nullptr, static_cast<std::size_t>(size), PROT_READ, MAP_PRIVATE, fd, 0);
+                if (data != MAP_FAILED)
+                {
+                    // Tell the kernel to read ahead aggressively and drop pages behind us.
+                    (void)::posix_madvise(data, static_cast<std::size_t>(size), POSIX_MADV_SEQUENTIAL);
+
+                    engine.update(data, static_cast<std::size_t>(size));
+
+                    ::munmap(data, static_cast<std::size_t>(size));
+                    return;
+                }
+            }
+
+            readReader.digest(fd, pathName, engine);
+        }
+    };
+
+    // Fills a ring of buffers from a second thread while the caller hashes the
+    // ones already filled. The semaphores count free and filled slots.
+    class ReadAhead : public Poco::Runnable
+    {
+    public:
+        explicit ReadAhead(int fd)
+            : fd_(fd), buffer_(READ_DEPTH * READ_BUFFER_SIZE), free_(READ_DEPTH, READ_DEPTH + 1), filled_(0, READ_DEPTH), stop_(false)
+        {
+        }
+
+        void run() override
+        {
+            for (unsigned i = 0;; i = (i + 1) % READ_DEPTH)
+            {
+                free_.wait();
+                if (stop_)
+                {
+                    break;
+                }
+
+                Slot &slot = slots_[i];
+                do
+                {
+                    slot.size = ::read(fd_, buffer_.get() + i * READ_BUFFER_SIZE, READ_BUFFER_SIZE);
+                    slot.error = errno;
+                } while (slot.size < 0 && slot.error == EINTR);
+
+                filled_.set();
+                if (slot.size <= 0)
+                {
+                    break;
+                }
+            }
+        }
+
+        void digest(const std::string &pathName, Poco::DigestEngine &engine)
+        {
+            Poco::Thread thread;
+            thread.start(*this);
+
+            try
+            {
+                for (unsigned i = 0;; i = (i + 1) % READ_DEPTH)
+                {
+                    filled_.wait();
+                    const Slot &slot = slots_[i];
+                    if (slot.size < 0)
+                    {
+                        thread.join();
+                        throw Poco::ReadFileException(pathName, slot.error);
+                    }
+                    if (slot.size == 0)
+                    {
+                        break;
+                    }
+
+                    engine.update(buffer_.get() + i * READ_BUFFER_SIZE, static_cast<std::size_t>(slot.size));
+                    free_.set();
+                }
+            }
+            catch (const Poco::ReadFileException &)
+            {
+                throw;
+            }
+            catch (...)
+            {
+                stop_ = true;
+                free_.set();
+                thread.join();
+                throw;
+            }
+
+            thread.join();
+        }
+
+    private:
+        struct Slot
+        {
+            ssize_t size = 0;
+            int error = 0;
+        };
+
+        int fd_;
+        AlignedBuffer buffer_;
+        Slot slots_[READ_DEPTH];
+        Poco::Semaphore free_;
+        Poco::Semaphore filled_;
+        std::atomic<bool> stop_; // set by digest(), read by the reader thread
+    };
+
+    class ReadAheadReader : public FileReader
+    {
+    public:
+        const char *name() const override { return "readahead"; }
+
+        void digest(int fd, const std::string &pathName, Poco::DigestEngine &engine) const override
+        {
+            off_t size = 0;
+            if (!IsLargeRegularFile(fd, READ_AHEAD_THRESHOLD, size))
+            {
+                readReader.digest(fd, pathName, engine);
+                return;
+            }
+
+            ReadAhead readAhead(fd);
+            readAhead.digest(pathName, engine);
+        }
+    };
+
+    const ReadAheadReader readAheadReader;
+
+#if defined(SHA256SUM_IO_URING)
+    // A minimal io_uring driven by raw system calls, so there's no dependency
+    // on liburing. Each thread that reads through it gets its own ring, and
+    // READ_DEPTH buffers registered with the kernel once, so reads skip
+    // pinning and unpinning pages every time.
+    class Ring
+    {
+    public:
+        Ring() : fd_(-1), sqRing_(MAP_FAILED), cqRing_(MAP_FAILED), sqes_(MAP_FAILED), sqRingSize_(0), cqRingSize_(0), sqesSize_(0), buffer_(READ_DEPTH * READ_BUFFER_SIZE), registered_(false)
+        {
+            struct io_uring_params params;
+            std::memset(&params, 0, sizeof(params));
+            fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, READ_DEPTH, &params));
+            if (fd_ < 0)
+            {
+                return;
+            }
+
+            sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+            if (params.features & IORING_FEAT_SINGLE_MMAP)
+            {
+                sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+            }
+            sqesSize_ = params.sq_entries * sizeof(struct io_uring_sqe);
+
+            sqRing_ = ::mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+            if (sqRing_ == MAP_FAILED)
+            {
+                return;
+            }
+            if (params.features & IORING_FEAT_SINGLE_MMAP)
+            {
+                cqRing_ = sqRing_;
+            }
+            else
+            {
+                cqRing_ = ::mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+                if (cqRing_ == MAP_FAILED)
+                {
+                    return;
+                }
+            }
+            sqes_ = ::mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+            if (sqes_ == MAP_FAILED)
+            {
+                return;
+            }
+
+            unsigned char *sq = static_cast<unsigned char *>(sqRing_);
+            sqHead_ = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+            sqTail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+            sqMask_ = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+            sqArray_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+
+            unsigned char *cq = static_cast<unsigned char *>(cqRing_);
+            cqHead_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+            cqTail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+            cqMask_ = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+            cqes_ = reinterpret_cast<struct io_uring_cqe *>(cq + params.cq_off.cqes);
+
+            // Registration counts against RLIMIT_MEMLOCK on older kernels;
+            // without it, plain reads into the same buffers still work.
+            struct iovec iov[READ_DEPTH];
+            for (unsigned i = 0; i < READ_DEPTH; ++i)
+            {
+                iov[i].iov_base = buffer(i);
+                iov[i].iov_len = READ_BUFFER_SIZE;
+            }
+            registered_ = ::syscall(__NR_io_uring_register, fd_, IORING_REGISTER_BUFFERS, iov, READ_DEPTH) == 0;
+        }
+
+        ~Ring()
+        {
+            if (sqes_ != MAP_FAILED)
+            {
+                ::munmap(sqes_, sqesSize_);
+            }
+            if (cqRing_ != MAP_FAILED && cqRing_ != sqRing_)
+            {
+                ::munmap(cqRing_, cqRingSize_);
+            }
+            if (sqRing_ != MAP_FAILED)
+            {
+                ::munmap(sqRing_, sqRingSize_);
+            }
+            if (fd_ >= 0)
+            {
+                ::close(fd_);
+            }
+        }
+
+        bool isOpen() const { return fd_ >= 0 && sqes_ != MAP_FAILED; }
+
+        unsigned char *buffer(unsigned slot) const { return buffer_.get() + slot * READ_BUFFER_SIZE; }
+
+        // Queues a read of `length` bytes at `offset` into the slot's buffer,
+        // `skip` bytes in. The slot number comes back with the completion.
+        void queueRead(int fd, unsigned slot, std::size_t skip, Poco::UInt64 offset, std::size_t length)
+        {
+            const unsigned tail = *sqTail_;
+            const unsigned index = tail & sqMask_;
+            struct io_uring_sqe *sqe = static_cast<struct io_uring_sqe *>(sqes_) + index;
+            std::memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = registered_ ? IORING_OP_READ_FIXED : IORING_OP_READ;
+            sqe->fd = fd;
+            sqe->off = offset;
+            sqe->addr = reinterpret_cast<Poco::UInt64>(buffer(slot) + skip);
+            sqe->len = static_cast<unsigned>(length);
+            sqe->buf_index = static_cast<Poco::UInt16>(slot);
+            sqe->user_data = slot;
+            sqArray_[index] = index;
+            __atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+            ++unsubmitted_;
+        }
+
+        // Submits what's queued and waits for one completion.
+        bool complete(unsigned &slot, int &result)
+        {
+            for (;;)
+            {
+                const unsigned head = *cqHead_;
+                if (head != __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE))
+                {
+                    const struct io_uring_cqe &cqe = cqes_[head & cqMask_];
+                    slot = static_cast<unsigned>(cqe.user_data);
+                    result = cqe.res;
+                    __atomic_store_n(cqHead_, head + 1, __ATOMIC_RELEASE);
+                    return true;
+                }
+
+                const long n = ::syscall(__NR_io_uring_enter, fd_, unsubmitted_, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+                if (n < 0 && errno != EINTR)
+                {
+                    return false;
+                }
+                if (n > 0)
+                {
+                    unsubmitted_ -= std::min(unsubmitted_, static_cast<unsigned>(n));
+                }
+            }
+        }
+
+    private:
+        Ring(const Ring &);
+        Ring &operator=(const Ring &);
+
+        int fd_;
+        void *sqRing_;
+        void *cqRing_;
+        void *sqes_;
+        std::size_t sqRingSize_;
+        std::size_t cqRingSize_;
+        std::size_t sqesSize_;
+        unsigned *sqHead_ = nullptr;
+        unsigned *sqTail_ = nullptr;
+        unsigned sqMask_ = 0;
+        unsigned *sqArray_ = nullptr;
+        unsigned *cqHead_ = nullptr;
+        unsigned *cqTail_ = nullptr;
+        unsigned cqMask_ = 0;
+        struct io_uring_cqe *cqes_ = nullptr;
+        unsigned unsubmitted_ = 0;
+        AlignedBuffer buffer_;
+        bool registered_;
+    };
+
+    // Null if this thread couldn't get a ring, e.g. under a seccomp policy
+    // that forbids io_uring; it's only tried once per thread.
+    Ring *ThreadRing()
+    {
+        static thread_local Ring *ring = nullptr;
+        static thread_local bool tried = false;
+        static thread_local struct Owner
+        {
+            Ring *&ring;
+            ~Owner() { delete ring; }
+        } owner = {ring};
+
+        if (!tried)
+        {
+            tried = true;
+            Ring *candidate = new Ring;
+            if (candidate->isOpen())
+            {
+                ring = candidate;
+            }
+            else
+            {
+                delete candidate;
+            }
+        }
+        return ring;
+    }
+
+    class UringReader : public FileReader
+    {
+    public:
+        const char *name() const override { return "uring"; }
+
+        // Keeps READ_DEPTH consecutive reads in flight and hashes them in file
+        // order as they complete.
+        void digest(int fd, const std::string &pathName, Poco::DigestEngine &engine) const override
+        {
+            off_t size = 0;
+            const off_t position = ::lseek(fd, 0, SEEK_CUR);
+            Ring *ring = nullptr;
+            if (position < 0 || !IsLargeRegularFile(fd, READ_AHEAD_THRESHOLD, size) || !(ring = ThreadRing()))
+            {
+                readAheadReader.digest(fd, pathName, engine);
+                return;
+            }
+
+            struct Slot
+            {
+                Poco::UInt64 offset;
+                std::size_t wanted;
+                std::size_t filled;
+                bool busy;
+            } slots[READ_DEPTH] = {};
+
+            Poco::UInt64 end = static_cast<Poco::UInt64>(size);
+            Poco::UInt64 next = static_cast<Poco::UInt64>(position);
+            unsigned inFlight = 0;
+            int error = 0;
+
+            for (unsigned i = 0; i < READ_DEPTH && next < end; ++i)
+            {
+                slots[i].offset = next;
+                slots[i].wanted = static_cast<std::size_t>(std::min<Poco::UInt64>(READ_BUFFER_SIZE, end - next));
+                slots[i].filled = 0;
+                slots[i].busy = true;
+                ring->queueRead(fd, i, 0, next, slots[i].wanted);
+                next += slots[i].wanted;
+                ++inFlight;
+            }
+
+            // Slots are handed out in file order, so the one to hash next is
+            // always the next in the ring.
+            unsigned current = 0;
+            while (inFlight > 0)
+            {
+                unsigned slot = 0;
+                int result = 0;
+                if (!ring->complete(slot, result))
+                {
+                    throw Poco::ReadFileException(pathName, errno);
+                }
+                --inFlight;
+
+                Slot &s = slots[slot];
+                if (result == -EINTR || result == -EAGAIN)
+                {
+                    result = 0;
+                }
+                else if (result < 0)
+                {
+                    error = -result;
+                    s.busy = false;
+                    continue;
+                }
+                else if (result == 0)
+                {
+                    // The file shrank: this is the end now.
+                    s.wanted = s.filled;
+                    end = std::min(end, s.offset + s.filled);
+                }
+
+                s.filled += static_cast<std::size_t>(result);
+                if (s.filled < s.wanted && error == 0)
+                {
+                    ring->queueRead(fd, slot, s.filled, s.offset + s.filled, s.wanted - s.filled);
+                    ++inFlight;
+                    continue;
+                }
+                s.busy = false;
+
+                // Once there's an error, just let the reads in flight land;
+                // the kernel may still be writing into the buffers.
+                while (error == 0 && !slots[current].busy && slots[current].wanted > 0)
+                {
+                    Slot &ready = slots[current];
+                    if (ready.offset < end)
+                    {
+                        engine.update(ring->buffer(current), ready.filled);
+                    }
+                    ready.wanted = 0;
+
+                    if (next < end)
+                    {
+                        ready.offset = next;
+                        ready.wanted = static_cast<std::size_t>(std::min<Poco::UInt64>(READ_BUFFER_SIZE, end - next));
+                        ready.filled = 0;
+                        ready.busy = true;
+                        ring->queueRead(fd, current, 0, next, ready.wanted);
+                        next += ready.wanted;
+                        ++inFlight;
+                    }
+                    current = (current + 1) % READ_DEPTH;
+                }
+            }
+
+            if (error != 0)
+            {
+                throw Poco::ReadFileException(pathName, error);
+            }
+            (void)::lseek(fd, static_cast<off_t>(end), SEEK_SET);
+        }
+    };
+#endif
+
+    std::vector<const FileReader *> Readers()
+    {
+        static const MmapReader mmapReader;
+        std::vector<const FileReader *> readers;
+        readers.push_back(&mmapReader);
+        readers.push_back(&readReader);
+        readers.push_back(&readAheadReader);
+#if defined(SHA256SUM_IO_URING)
+        static const UringReader uringReader;
+        readers.push_back(&uringReader);
+#endif
+        return readers;
+    }
+#else
+    class StreamReader : public FileReader
+    {
+    public:
+        const char *name() const override { return "read"; }
+    };
+
+    std::vector<const FileReader *> Readers()
+    {
+        static const StreamReader streamReader;
+        return std::vector<const FileReader *>(1, &streamReader);
+    }
+#endif
+}
+
+const FileReader &FileReader::select(const std::string &name)
+{
+    const std::vector<const FileReader *> readers(Readers());
+    if (name == "auto")
+    {
+        return *readers.front();
+    }
+
+    for (const FileReader *reader : readers)
+    {
+        if (name == reader->name())
+        {
+            return *reader;
+        }
+    }
+
+    throw Poco::InvalidArgumentException("I/O engine not available", name);
+}
+
+std::vector<std::string> FileReader::available()
+{
+    std::vector<std::string> names;
+    for (const FileReader *reader : Readers())
+    {
+        names.push_back(reader->name());
+    }
+    return names;
+}
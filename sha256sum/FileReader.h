@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Package: Core
+#include <Poco/Foundation.h>
+
+// Package: Crypt
+#include <Poco/DigestEngine.h>
+
+// How a file's bytes get from the disk to the digest engine.
+//
+// "mmap" maps regular files and lets the kernel's readahead feed the engine;
+// it's the fastest when the file is already cached. The others keep reads in
+// flight while the engine hashes what has arrived, which is what counts on a
+// cold cache, NVMe or network storage: "readahead" fills a ring of buffers
+// from a second thread, and "uring" keeps several reads queued on a per-thread
+// io_uring with buffers registered once for the thread's lifetime. Where
+// io_uring isn't available it falls back to "readahead". "read" is plain
+// blocking read() calls.
+//
+// Elsewhere than Unix, files are read through a FileInputStream whatever the
+// choice.
+class FileReader
+{
+public:
+    virtual ~FileReader() {}
+
+    // Name as accepted by --io.
+    virtual const char *name() const = 0;
+
+#if defined(POCO_OS_FAMILY_UNIX)
+    // Feeds everything from the file's current position on into the engine.
+    // `pathName` only appears in error messages.
+    virtual void digest(int fd, const std::string &pathName, Poco::DigestEngine &engine) const = 0;
+#endif
+
+    // Returns the named reader; "auto" is "mmap". Throws
+    // Poco::InvalidArgumentException for unknown names.
+    static const FileReader &select(const std::string &name);
+
+    // Names of the readers built into this binary.
+    static std::vector<std::string> available();
+};
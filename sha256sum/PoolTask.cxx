@@ -0,0 +1,63 @@
+#include "PoolTask.h"
+
+// Package: Core
+#include <Poco/AutoPtr.h>
+
+namespace
+{
+    // How often a waiting thread looks up from the queue to see whether the
+    // last task, running elsewhere, has finished.
+    const long POLL_MILLISECONDS = 20;
+}
+
+// The count starts at one, for the thread that will wait: tasks can finish as
+// fast as they're queued, and the group mustn't look done until wait() says so.
+TaskGroup::TaskGroup(Poco::NotificationQueue &queue) : queue_(queue), outstanding_(1), finished_(false)
+{
+}
+
+void TaskGroup::enqueue(PoolTask *task)
+{
+    ++outstanding_;
+    queue_.enqueueNotification(task);
+}
+
+void TaskGroup::finish()
+{
+    if (--outstanding_ == 0)
+    {
+        finished_.set();
+    }
+}
+
+void TaskGroup::wait()
+{
+    finish();
+    while (!finished_.tryWait(0))
+    {
+        Poco::AutoPtr<Poco::Notification> notification(queue_.waitDequeueNotification(POLL_MILLISECONDS));
+        PoolTask *task = dynamic_cast<PoolTask *>(notification.get());
+        if (task)
+        {
+            task->run();
+        }
+    }
+    finished_.reset();
+    outstanding_ = 1;
+}
+
+Poco::Exception *CaptureException()
+{
+    try
+    {
+        throw;
+    }
+    catch (const Poco::Exception &e)
+    {
+        return e.clone();
+    }
+    catch (const std::exception &e)
+    {
+        return new Poco::Exception(e.what());
+    }
+}
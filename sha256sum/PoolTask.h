@@ -0,0 +1,47 @@
+#pragma once
+
+// Package: Core
+#include <Poco/AtomicCounter.h>
+#include <Poco/Exception.h>
+
+// Package: Threading
+#include <Poco/Event.h>
+#include <Poco/Notification.h>
+#include <Poco/NotificationQueue.h>
+
+// Work for the hashing pool, queued on the NotificationQueue its workers read.
+// Workers run it and let go.
+class PoolTask : public Poco::Notification
+{
+public:
+    virtual void run() noexcept = 0;
+};
+
+// Keeps count of a set of PoolTasks, which may queue more of their own, so the
+// thread that started them can help out until the last one has run.
+class TaskGroup
+{
+public:
+    explicit TaskGroup(Poco::NotificationQueue &queue);
+
+    // Queues a task. It must call finish() when it's done.
+    void enqueue(PoolTask *task);
+    void finish();
+
+    // Runs tasks off the queue until every task in the group has finished.
+    // Nothing but PoolTasks may be queued meanwhile.
+    void wait();
+
+private:
+    TaskGroup(const TaskGroup &);
+    TaskGroup &operator=(const TaskGroup &);
+
+    Poco::NotificationQueue &queue_;
+    Poco::AtomicCounter outstanding_;
+    Poco::Event finished_;
+};
+
+// Called from a catch block: a copy of the exception in flight, to be kept
+// and rethrown on another thread. Anything not derived from std::exception
+// isn't caught.
+Poco::Exception *CaptureException();
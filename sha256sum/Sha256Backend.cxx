@@ -0,0 +1,612 @@
+#include "Sha256Backend.h"
+
+#include <algorithm>
+#include <cstring>
+
+// Package: Core
+#include <Poco/Exception.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#include <immintrin.h>
+#define SHA256_X86 1
+#define SHA256_TARGET(features) __attribute__((target(features)))
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <immintrin.h>
+#define SHA256_X86 1
+#define SHA256_TARGET(features)
+#endif
+
+namespace
+{
+    const Poco::UInt32 K[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+    const Poco::UInt32 INITIAL_STATE[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+    inline Poco::UInt32 LoadBigEndian32(const unsigned char *p)
+    {
+        return (static_cast<Poco::UInt32>(p[0]) << 24) | (static_cast<Poco::UInt32>(p[1]) << 16) |
+               (static_cast<Poco::UInt32>(p[2]) << 8) | static_cast<Poco::UInt32>(p[3]);
+    }
+
+    inline void StoreBigEndian32(unsigned char *p, Poco::UInt32 value)
+    {
+        p[0] = static_cast<unsigned char>(value >> 24);
+        p[1] = static_cast<unsigned char>(value >> 16);
+        p[2] = static_cast<unsigned char>(value >> 8);
+        p[3] = static_cast<unsigned char>(value);
+    }
+
+    inline void StoreBigEndian64(unsigned char *p, Poco::UInt64 value)
+    {
+        StoreBigEndian32(p, static_cast<Poco::UInt32>(value >> 32));
+        StoreBigEndian32(p + 4, static_cast<Poco::UInt32>(value));
+    }
+
+    inline Poco::UInt32 Rotr(Poco::UInt32 x, unsigned n)
+    {
+        return (x >> n) | (x << (32 - n));
+    }
+
+    // Scalar
+
+    void ScalarCompress(Poco::UInt32 state[8], const unsigned char *data, std::size_t blocks)
+    {
+        Poco::UInt32 w[64];
+        for (; blocks > 0; --blocks, data += 64)
+        {
+            for (unsigned t = 0; t < 16; ++t)
+            {
+                w[t] = LoadBigEndian32(data + 4 * t);
+            }
+            for (unsigned t = 16; t < 64; ++t)
+            {
+                const Poco::UInt32 s0 = Rotr(w[t - 15], 7) ^ Rotr(w[t - 15], 18) ^ (w[t - 15] >> 3);
+                const Poco::UInt32 s1 = Rotr(w[t - 2], 17) ^ Rotr(w[t - 2], 19) ^ (w[t - 2] >> 10);
+                w[t] = w[t - 16] + s0 + w[t - 7] + s1;
+            }
+
+            Poco::UInt32 a = state[0], b = state[1], c = state[2], d = state[3];
+            Poco::UInt32 e = state[4], f = state[5], g = state[6], h = state[7];
+            for (unsigned t = 0; t < 64; ++t)
+            {
+                const Poco::UInt32 t1 = h + (Rotr(e, 6) ^ Rotr(e, 11) ^ Rotr(e, 25)) + ((e & f) ^ (~e & g)) + K[t] + w[t];
+                const Poco::UInt32 t2 = (Rotr(a, 2) ^ Rotr(a, 13) ^ Rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+                h = g;
+                g = f;
+                f = e;
+                e = d + t1;
+                d = c;
+                c = b;
+                b = a;
+                a = t1 + t2;
+            }
+
+            state[0] += a;
+            state[1] += b;
+            state[2] += c;
+            state[3] += d;
+            state[4] += e;
+            state[5] += f;
+            state[6] += g;
+            state[7] += h;
+        }
+    }
+
+    class ScalarBackend : public Sha256Backend
+    {
+    public:
+        const char *name() const override { return "scalar"; }
+
+        void compress(Poco::UInt32 state[8], const unsigned char *data, std::size_t blocks) const override
+        {
+            ScalarCompress(state, data, blocks);
+        }
+    };
+
+#if defined(SHA256_X86)
+    // CPU feature detection
+
+    struct CpuFeatures
+    {
+        bool sha = false;
+        bool avx2 = false;
+    };
+
+    void Cpuid(unsigned leaf, unsigned subleaf, unsigned regs[4])
+    {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuidex(info, static_cast<int>(leaf), static_cast<int>(subleaf));
+        for (unsigned i = 0; i < 4; ++i)
+        {
+            regs[i] = static_cast<unsigned>(info[i]);
+        }
+#else
+        regs[0] = regs[1] = regs[2] = regs[3] = 0;
+        __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    }
+
+    // The OS has to save the YMM registers on context switch for AVX to be usable.
+    bool OsSavesYmm()
+    {
+#if defined(_MSC_VER)
+        return (_xgetbv(0) & 6) == 6;
+#else
+        unsigned eax, edx;
+        __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        return (eax & 6) == 6;
+#endif
+    }
+
+    CpuFeatures DetectCpuFeatures()
+    {
+        CpuFeatures features;
+
+        unsigned regs[4];
+        Cpuid(0, 0, regs);
+        const unsigned maxLeaf = regs[0];
+        if (maxLeaf < 7)
+        {
+            return features;
+        }
+
+        Cpuid(1, 0, regs);
+        const bool ssse3 = (regs[2] & (1u << 9)) != 0;
+        const bool sse41 = (regs[2] & (1u << 19)) != 0;
+        const bool osxsave = (regs[2] & (1u << 27)) != 0;
+        const bool avx = (regs[2] & (1u << 28)) != 0;
+
+        Cpuid(7, 0, regs);
+        features.sha = ssse3 && sse41 && (regs[1] & (1u << 29)) != 0;
+        features.avx2 = osxsave && avx && OsSavesYmm() && (regs[1] & (1u << 5)) != 0;
+        return features;
+    }
+
+    const CpuFeatures &GetCpuFeatures()
+    {
+        static const CpuFeatures features(DetectCpuFeatures());
+        return features;
+    }
+
+    // SHA-NI: four rounds per pair of sha256rnds2, with the message schedule
+    // computed four words at a time by sha256msg1/sha256msg2.
+
+    SHA256_TARGET("sha,sse4.1,ssse3")
+    void ShaNiCompress(Poco::UInt32 state[8], const unsigned char *data, std::size_t blocks)
+    {
+        const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+        // The instructions want the state as ABEF/CDGH rather than ABCD/EFGH.
+        __m128i tmp = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&state[0]));
+        __m128i state1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&state[4]));
+        tmp = _mm_shuffle_epi32(tmp, 0xB1);
+        state1 = _mm_shuffle_epi32(state1, 0x1B);
+        __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+        state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+        for (; blocks > 0; --blocks, data += 64)
+        {
+            const __m128i abefSave = state0;
+            const __m128i cdghSave = state1;
+
+            __m128i msg[4];
+            for (unsigned i = 0; i < 4; ++i)
+            {
+                msg[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 16 * i)), byteSwap);
+            }
+
+            for (unsigned g = 0; g < 16; ++g)
+            {
+                __m128i &current = msg[g & 3];
+                __m128i &next = msg[(g + 1) & 3];
+                __m128i &previous = msg[(g + 3) & 3];
+
+                __m128i rounds = _mm_add_epi32(current, _mm_loadu_si128(reinterpret_cast<const __m128i *>(&K[4 * g])));
+                state1 = _mm_sha256rnds2_epu32(state1, state0, rounds);
+                if (g >= 3 && g <= 14)
+                {
+                    next = _mm_add_epi32(next, _mm_alignr_epi8(current, previous, 4));
+                    next = _mm_sha256msg2_epu32(next, current);
+                }
+                rounds = _mm_shuffle_epi32(rounds, 0x0E);
+                state0 = _mm_sha256rnds2_epu32(state0, state1, rounds);
+                if (g >= 1 && g <= 12)
+                {
+                    previous = _mm_sha256msg1_epu32(previous, current);
+                }
+            }
+
+            state0 = _mm_add_epi32(state0, abefSave);
+            state1 = _mm_add_epi32(state1, cdghSave);
+        }
+
+        tmp = _mm_shuffle_epi32(state0, 0x1B);
+        state1 = _mm_shuffle_epi32(state1, 0xB1);
+        state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+        state1 = _mm_alignr_epi8(state1, tmp, 8);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(&state[0]), state0);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(&state[4]), state1);
+    }
+
+    class ShaNiBackend : public Sha256Backend
+    {
+    public:
+        const char *name() const override { return "shani"; }
+
+        void compress(Poco::UInt32 state[8], const unsigned char *data, std::size_t blocks) const override
+        {
+            ShaNiCompress(state, data, blocks);
+        }
+    };
+
+    // AVX2: eight messages in lockstep, one per 32-bit lane.
+
+    SHA256_TARGET("avx2")
+    inline __m256i Rotr8x(__m256i x, int n)
+    {
+        return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n));
+    }
+
+    SHA256_TARGET("avx2")
+    inline __m256i Add8x(__m256i a, __m256i b)
+    {
+        return _mm256_add_epi32(a, b);
+    }
+
+    SHA256_TARGET("avx2")
+    void Avx2CompressMulti(Poco::UInt32 *const states[], const unsigned char *const data[], std::size_t blocks)
+    {
+        __m256i s[8];
+        for (unsigned k = 0; k < 8; ++k)
+        {
+            s[k] = _mm256_setr_epi32(
+                static_cast<int>(states[0][k]), static_cast<int>(states[1][k]),
+                static_cast<int>(states[2][k]), static_cast<int>(states[3][k]),
+                static_cast<int>(states[4][k]), static_cast<int>(states[5][k]),
+                static_cast<int>(states[6][k]), static_cast<int>(states[7][k]));
+        }
+
+        __m256i w[16];
+        for (std::size_t block = 0; block < blocks; ++block)
+        {
+            const std::size_t offset = 64 * block;
+            for (unsigned t = 0; t < 16; ++t)
+            {
+                w[t] = _mm256_setr_epi32(
+                    static_cast<int>(LoadBigEndian32(data[0] + offset + 4 * t)),
+                    static_cast<int>(LoadBigEndian32(data[1] + offset + 4 * t)),
+                    static_cast<int>(LoadBigEndian32(data[2] + offset + 4 * t)),
+                    static_cast<int>(LoadBigEndian32(data[3] + offset + 4 * t)),
+                    static_cast<int>(LoadBigEndian32(data[4] + offset + 4 * t)),
+                    static_cast<int>(LoadBigEndian32(data[5] + offset + 4 * t)),
+                    static_cast<int>(LoadBigEndian32(data[6] + offset + 4 * t)),
+                    static_cast<int>(LoadBigEndian32(data[7] + offset + 4 * t)));
+            }
+
+            __m256i a = s[0], b = s[1], c = s[2], d = s[3];
+            __m256i e = s[4], f = s[5], g = s[6], h = s[7];
+            for (unsigned t = 0; t < 64; ++t)
+            {
+                if (t >= 16)
+                {
+                    const __m256i w15 = w[(t - 15) & 15];
+                    const __m256i w2 = w[(t - 2) & 15];
+                    const __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(Rotr8x(w15, 7), Rotr8x(w15, 18)), _mm256_srli_epi32(w15, 3));
+                    const __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(Rotr8x(w2, 17), Rotr8x(w2, 19)), _mm256_srli_epi32(w2, 10));
+                    w[t & 15] = Add8x(Add8x(w[t & 15], s0), Add8x(w[(t - 7) & 15], s1));
+                }
+
+                const __m256i sigma1 = _mm256_xor_si256(_mm256_xor_si256(Rotr8x(e, 6), Rotr8x(e, 11)), Rotr8x(e, 25));
+                const __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+                const __m256i t1 = Add8x(Add8x(Add8x(h, sigma1), Add8x(ch, w[t & 15])), _mm256_set1_epi32(static_cast<int>(K[t])));
+                const __m256i sigma0 = _mm256_xor_si256(_mm256_xor_si256(Rotr8x(a, 2), Rotr8x(a, 13)), Rotr8x(a, 22));
+                const __m256i maj = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+                const __m256i t2 = Add8x(sigma0, maj);
+                h = g;
+                g = f;
+                f = e;
+                e = Add8x(d, t1);
+                d = c;
+                c = b;
+                b = a;
+                a = Add8x(t1, t2);
+            }
+
+            s[0] = Add8x(s[0], a);
+            s[1] = Add8x(s[1], b);
+            s[2] = Add8x(s[2], c);
+            s[3] = Add8x(s[3], d);
+            s[4] = Add8x(s[4], e);
+            s[5] = Add8x(s[5], f);
+            s[6] = Add8x(s[6], g);
+            s[7] = Add8x(s[7], h);
+        }
+
+        for (unsigned k = 0; k < 8; ++k)
+        {
+            Poco::UInt32 lanes[8];
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), s[k]);
+            for (unsigned lane = 0; lane < 8; ++lane)
+            {
+                states[lane][k] = lanes[lane];
+            }
+        }
+    }
+
+    // A single stream gains nothing from AVX2, so it goes through the scalar kernel.
+    class Avx2Backend : public Sha256Backend
+    {
+    public:
+        const char *name() const override { return "avx2"; }
+
+        void compress(Poco::UInt32 state[8], const unsigned char *data, std::size_t blocks) const override
+        {
+            ScalarCompress(state, data, blocks);
+        }
+
+        unsigned lanes() const override { return 8; }
+
+        void compressMulti(Poco::UInt32 *const states[], const unsigned char *const data[], std::size_t blocks) const override
+        {
+            Avx2CompressMulti(states, data, blocks);
+        }
+    };
+#endif
+
+    // All backends this CPU can run, fastest first.
+    std::vector<const Sha256Backend *> SupportedBackends()
+    {
+        std::vector<const Sha256Backend *> backends;
+
+#if defined(SHA256_X86)
+        static const ShaNiBackend shaNi;
+        static const Avx2Backend avx2;
+        if (GetCpuFeatures().sha)
+        {
+            backends.push_back(&shaNi);
+        }
+        if (GetCpuFeatures().avx2)
+        {
+            backends.push_back(&avx2);
+        }
+#endif
+
+        static const ScalarBackend scalar;
+        backends.push_back(&scalar);
+        return backends;
+    }
+
+    // One message being hashed by Sha256DigestMany: its whole blocks straight
+    // from the caller's buffer, then one or two padded blocks from tail.
+    struct Lane
+    {
+        const unsigned char *data;
+        std::size_t dataBlocks;
+        std::size_t totalBlocks;
+        std::size_t position;
+        unsigned char tail[128];
+        Poco::UInt32 state[8];
+
+        void start(const std::string &message)
+        {
+            data = reinterpret_cast<const unsigned char *>(message.data());
+            dataBlocks = message.size() / 64;
+
+            const std::size_t remainder = message.size() % 64;
+            const std::size_t tailBlocks = remainder + 9 <= 64 ? 1 : 2;
+            std::memset(tail, 0, sizeof(tail));
+            std::memcpy(tail, data + 64 * dataBlocks, remainder);
+            tail[remainder] = 0x80;
+            StoreBigEndian64(tail + 64 * tailBlocks - 8, static_cast<Poco::UInt64>(message.size()) * 8);
+
+            totalBlocks = dataBlocks + tailBlocks;
+            position = 0;
+            std::memcpy(state, INITIAL_STATE, sizeof(state));
+        }
+
+        std::size_t remaining() const { return totalBlocks - position; }
+
+        // Blocks available contiguously from the current position.
+        std::size_t run() const { return position < dataBlocks ? dataBlocks - position : totalBlocks - position; }
+
+        const unsigned char *current() const
+        {
+            return position < dataBlocks ? data + 64 * position : tail + 64 * (position - dataBlocks);
+        }
+    };
+
+    void StoreDigest(const Poco::UInt32 state[8], Poco::DigestEngine::Digest &digest)
+    {
+        digest.resize(32);
+        for (unsigned i = 0; i < 8; ++i)
+        {
+            StoreBigEndian32(&digest[4 * i], state[i]);
+        }
+    }
+}
+
+void Sha256Backend::compressMulti(Poco::UInt32 *const states[], const unsigned char *const data[], std::size_t blocks) const
+{
+    for (unsigned lane = 0; lane < lanes(); ++lane)
+    {
+        compress(states[lane], data[lane], blocks);
+    }
+}
+
+const Sha256Backend &Sha256Backend::select(const std::string &name)
+{
+    const std::vector<const Sha256Backend *> backends(SupportedBackends());
+    if (name == "auto")
+    {
+        return *backends.front();
+    }
+
+    for (const Sha256Backend *backend : backends)
+    {
+        if (name == backend->name())
+        {
+            return *backend;
+        }
+    }
+
+    throw Poco::InvalidArgumentException("SHA-256 backend not supported on this machine", name);
+}
+
+std::vector<std::string> Sha256Backend::available()
+{
+    std::vector<std::string> names;
+    for (const Sha256Backend *backend : SupportedBackends())
+    {
+        names.push_back(backend->name());
+    }
+    return names;
+}
+
+Sha256Engine::Sha256Engine(const Sha256Backend &backend) : backend_(backend)
+{
+    reset();
+}
+
+std::size_t Sha256Engine::digestLength() const
+{
+    return 32;
+}
+
+void Sha256Engine::reset()
+{
+    std::memcpy(state_, INITIAL_STATE, sizeof(state_));
+    buffered_ = 0;
+    length_ = 0;
+}
+
+const Poco::DigestEngine::Digest &Sha256Engine::digest()
+{
+    const Poco::UInt64 bits = length_ * 8;
+
+    buffer_[buffered_++] = 0x80;
+    if (buffered_ > 56)
+    {
+        std::memset(buffer_ + buffered_, 0, 64 - buffered_);
+        backend_.compress(state_, buffer_, 1);
+        buffered_ = 0;
+    }
+    std::memset(buffer_ + buffered_, 0, 56 - buffered_);
+    StoreBigEndian64(buffer_ + 56, bits);
+    backend_.compress(state_, buffer_, 1);
+
+    StoreDigest(state_, digest_);
+    reset();
+    return digest_;
+}
+
+void Sha256Engine::updateImpl(const void *data, std::size_t length)
+{
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    length_ += length;
+
+    if (buffered_ > 0)
+    {
+        const std::size_t n = std::min(length, 64 - buffered_);
+        std::memcpy(buffer_ + buffered_, bytes, n);
+        buffered_ += n;
+        bytes += n;
+        length -= n;
+        if (buffered_ < 64)
+        {
+            return;
+        }
+        backend_.compress(state_, buffer_, 1);
+        buffered_ = 0;
+    }
+
+    // Whole blocks are compressed in place, without going through buffer_.
+    const std::size_t blocks = length / 64;
+    if (blocks > 0)
+    {
+        backend_.compress(state_, bytes, blocks);
+        bytes += 64 * blocks;
+        length -= 64 * blocks;
+    }
+
+    std::memcpy(buffer_, bytes, length);
+    buffered_ = length;
+}
+
+void Sha256DigestMany(const Sha256Backend &backend, const std::vector<std::string> &messages, std::vector<Poco::DigestEngine::Digest> &digests)
+{
+    digests.resize(messages.size());
+
+    // Group messages of similar length so lanes finish together.
+    std::vector<std::size_t> order(messages.size());
+    for (std::size_t i = 0; i < order.size(); ++i)
+    {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&messages](std::size_t a, std::size_t b)
+              { return messages[a].size() < messages[b].size(); });
+
+    const unsigned width = backend.lanes();
+    std::vector<Lane> lanes(width);
+    std::vector<Poco::UInt32 *> states(width);
+    std::vector<const unsigned char *> data(width);
+
+    for (std::size_t first = 0; first < order.size(); first += width)
+    {
+        const std::size_t count = std::min<std::size_t>(width, order.size() - first);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            lanes[i].start(messages[order[first + i]]);
+        }
+
+        // Lockstep while every lane has work. Spare lanes in a short group
+        // redo lane 0's blocks into a scratch state.
+        Poco::UInt32 scratch[8] = {0};
+        bool busy = count > 1;
+        while (busy)
+        {
+            std::size_t blocks = lanes[0].run();
+            for (std::size_t i = 1; i < count; ++i)
+            {
+                blocks = std::min(blocks, lanes[i].run());
+            }
+            for (std::size_t i = 0; i < width; ++i)
+            {
+                const Lane &lane = lanes[i < count ? i : 0];
+                states[i] = i < count ? lanes[i].state : scratch;
+                data[i] = lane.current();
+            }
+            backend.compressMulti(states.data(), data.data(), blocks);
+
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                lanes[i].position += blocks;
+                busy = busy && lanes[i].remaining() > 0;
+            }
+        }
+
+        // Whatever is left of the longer messages runs one lane at a time.
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            Lane &lane = lanes[i];
+            while (lane.remaining() > 0)
+            {
+                const std::size_t blocks = lane.run();
+                backend.compress(lane.state, lane.current(), blocks);
+                lane.position += blocks;
+            }
+            StoreDigest(lane.state, digests[order[first + i]]);
+        }
+    }
+}
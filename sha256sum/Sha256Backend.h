@@ -0,0 +1,78 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Package: Core
+#include <Poco/Types.h>
+
+// Package: Crypt
+#include <Poco/DigestEngine.h>
+
+// A SHA-256 compression kernel.
+//
+// The scalar kernel runs everywhere. On x86 there's one built on the SHA
+// extensions (SHA-NI) and an AVX2 kernel that advances eight independent
+// messages at once, which pays off when hashing many small files.
+class Sha256Backend
+{
+public:
+    virtual ~Sha256Backend() {}
+
+    // Name as accepted by --backend.
+    virtual const char *name() const = 0;
+
+    // Runs the compression function over `blocks` consecutive 64-byte blocks.
+    virtual void compress(Poco::UInt32 state[8], const unsigned char *data, std::size_t blocks) const = 0;
+
+    // Number of messages compressMulti() advances in lockstep.
+    virtual unsigned lanes() const { return 1; }
+
+    // Runs `blocks` blocks of lanes() independent messages, one state and one
+    // data pointer per lane.
+    virtual void compressMulti(Poco::UInt32 *const states[], const unsigned char *const data[], std::size_t blocks) const;
+
+    // Returns the named backend; "auto" picks the fastest one this CPU supports.
+    // Throws Poco::InvalidArgumentException for unknown or unsupported names.
+    static const Sha256Backend &select(const std::string &name);
+
+    // Names of the backends this CPU supports, fastest first.
+    static std::vector<std::string> available();
+};
+
+// SHA-256 as a Poco::DigestEngine, computed with the given backend. A drop-in
+// replacement for Poco::SHA2Engine(Poco::SHA2Engine::SHA_256).
+class Sha256Engine : public Poco::DigestEngine
+{
+public:
+    explicit Sha256Engine(const Sha256Backend &backend);
+
+    std::size_t digestLength() const override;
+    void reset() override;
+    const Digest &digest() override;
+
+    // Bytes fed in since the last reset() or digest().
+    Poco::UInt64 length() const { return length_; }
+
+protected:
+    void updateImpl(const void *data, std::size_t length) override;
+
+private:
+    Sha256Engine(const Sha256Engine &);
+    Sha256Engine &operator=(const Sha256Engine &);
+
+    const Sha256Backend &backend_;
+    Poco::UInt32 state_[8];
+    unsigned char buffer_[64];
+    std::size_t buffered_;
+    Poco::UInt64 length_;
+    Digest digest_;
+};
+
+// Files up to this size are read whole and hashed together on multi-buffer
+// backends; anything larger streams through its own engine.
+const std::size_t MULTI_BUFFER_FILE_LIMIT = 64 * 1024;
+
+// Hashes complete in-memory messages, lanes() at a time on multi-buffer
+// backends. digests[i] is the SHA-256 of messages[i].
+void Sha256DigestMany(const Sha256Backend &backend, const std::vector<std::string> &messages, std::vector<Poco::DigestEngine::Digest> &digests);
@@ -0,0 +1,135 @@
+#include "Stats.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+
+HashStats::HashStats() : files_(0), bytes_(0), cacheHits_(0), errors_(0), maximum_(0)
+{
+    std::memset(buckets_, 0, sizeof(buckets_));
+}
+
+void HashStats::recordFile(Poco::UInt64 bytes, Poco::UInt64 nanoseconds)
+{
+    Poco::FastMutex::ScopedLock lock(mutex_);
+    ++files_;
+    bytes_ += bytes;
+    record(nanoseconds);
+}
+
+void HashStats::recordCacheHit(Poco::UInt64 nanoseconds)
+{
+    Poco::FastMutex::ScopedLock lock(mutex_);
+    ++files_;
+    ++cacheHits_;
+    record(nanoseconds);
+}
+
+void HashStats::recordError()
+{
+    Poco::FastMutex::ScopedLock lock(mutex_);
+    ++errors_;
+}
+
+Poco::UInt64 HashStats::files() const
+{
+    Poco::FastMutex::ScopedLock lock(mutex_);
+    return files_;
+}
+
+Poco::UInt64 HashStats::bytes() const
+{
+    Poco::FastMutex::ScopedLock lock(mutex_);
+    return bytes_;
+}
+
+Poco::UInt64 HashStats::percentile(double q) const
+{
+    Poco::FastMutex::ScopedLock lock(mutex_);
+
+    Poco::UInt64 total = 0;
+    for (unsigned i = 0; i < BUCKETS; ++i)
+    {
+        total += buckets_[i];
+    }
+    if (total == 0)
+    {
+        return 0;
+    }
+
+    // The rank of the sample wanted, counting from one.
+    const Poco::UInt64 rank = std::max<Poco::UInt64>(1, static_cast<Poco::UInt64>(q * static_cast<double>(total) + 0.5));
+    Poco::UInt64 seen = 0;
+    for (unsigned i = 0; i < BUCKETS; ++i)
+    {
+        seen += buckets_[i];
+        if (seen >= rank)
+        {
+            return std::min(bucketLimit(i), maximum_);
+        }
+    }
+    return maximum_;
+}
+
+void HashStats::report(std::ostream &out, double seconds) const
+{
+    Poco::UInt64 files, bytes, cacheHits, errors, maximum;
+    {
+        Poco::FastMutex::ScopedLock lock(mutex_);
+        files = files_;
+        bytes = bytes_;
+        cacheHits = cacheHits_;
+        errors = errors_;
+        maximum = maximum_;
+    }
+    const double rate = seconds > 0 ? 1 / seconds : 0;
+
+    const std::ios::fmtflags flags(out.flags());
+    out << std::fixed << std::setprecision(1)
+        << "files: " << files << " (" << cacheHits << " from cache, " << errors << " failed)" << std::endl
+        << "bytes: " << bytes << std::endl
+        << "time: " << std::setprecision(3) << seconds << " s" << std::endl
+        << std::setprecision(1)
+        << "throughput: " << bytes * rate / (1024 * 1024) << " MB/s, " << files * rate << " files/s" << std::endl
+        << "latency: p50 " << percentile(0.50) / 1000.0 << " us, p99 " << percentile(0.99) / 1000.0
+        << " us, max " << maximum / 1000.0 << " us" << std::endl;
+    out.flags(flags);
+}
+
+// Values below SUB_BUCKETS get a bucket each; above, every power of two is
+// split into SUB_BUCKETS equal parts.
+unsigned HashStats::bucketOf(Poco::UInt64 nanoseconds)
+{
+    if (nanoseconds < SUB_BUCKETS)
+    {
+        return static_cast<unsigned>(nanoseconds);
+    }
+
+    unsigned msb = 63;
+    while (!(nanoseconds >> msb))
+    {
+        --msb;
+    }
+    const unsigned shift = msb - 4;
+    return (msb - 3) * SUB_BUCKETS + static_cast<unsigned>((nanoseconds >> shift) & (SUB_BUCKETS - 1));
+}
+
+// The largest value that falls in the bucket.
+Poco::UInt64 HashStats::bucketLimit(unsigned bucket)
+{
+    if (bucket < SUB_BUCKETS)
+    {
+        return bucket;
+    }
+
+    const unsigned msb = bucket / SUB_BUCKETS + 3;
+    const unsigned shift = msb - 4;
+    const Poco::UInt64 first = (Poco::UInt64(SUB_BUCKETS) | (bucket % SUB_BUCKETS)) << shift;
+    return first + ((Poco::UInt64(1) << shift) - 1);
+}
+
+void HashStats::record(Poco::UInt64 nanoseconds)
+{
+    ++buckets_[bucketOf(nanoseconds)];
+    maximum_ = std::max(maximum_, nanoseconds);
+}
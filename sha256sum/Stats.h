@@ -0,0 +1,66 @@
+#pragma once
+
+#include <chrono>
+#include <ostream>
+
+// Package: Core
+#include <Poco/Mutex.h>
+#include <Poco/Types.h>
+
+// Throughput counters and a per-file latency histogram, for --stats and
+// sha256sum_bench.
+//
+// Latencies go into log-linear buckets, 16 to each power of two, so a
+// percentile read back is within about 6% of the true value whatever the
+// range. Recording takes a lock; it happens once per file, against the cost of
+// opening and hashing it.
+class HashStats
+{
+public:
+    // Measures from construction to elapsed().
+    class Timer
+    {
+    public:
+        Timer() : start_(std::chrono::steady_clock::now()) {}
+
+        Poco::UInt64 elapsed() const
+        {
+            return static_cast<Poco::UInt64>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_).count());
+        }
+
+    private:
+        std::chrono::steady_clock::time_point start_;
+    };
+
+    HashStats();
+
+    void recordFile(Poco::UInt64 bytes, Poco::UInt64 nanoseconds);
+    void recordCacheHit(Poco::UInt64 nanoseconds);
+    void recordError();
+
+    Poco::UInt64 files() const;
+    Poco::UInt64 bytes() const;
+
+    // The latency below which a fraction q of files fell, in nanoseconds.
+    Poco::UInt64 percentile(double q) const;
+
+    // Prints the counters, with rates over `seconds` of wall time.
+    void report(std::ostream &out, double seconds) const;
+
+private:
+    static const unsigned SUB_BUCKETS = 16;
+    static const unsigned BUCKETS = 61 * SUB_BUCKETS;
+
+    static unsigned bucketOf(Poco::UInt64 nanoseconds);
+    static Poco::UInt64 bucketLimit(unsigned bucket);
+
+    void record(Poco::UInt64 nanoseconds);
+
+    mutable Poco::FastMutex mutex_;
+    Poco::UInt64 files_;
+    Poco::UInt64 bytes_;
+    Poco::UInt64 cacheHits_;
+    Poco::UInt64 errors_;
+    Poco::UInt64 maximum_;
+    Poco::UInt64 buckets_[BUCKETS];
+};
@@ -0,0 +1,606 @@
+#include "TreeWalker.h"
+
+#include <algorithm>
+
+// Package: Filesystem
+#include <Poco/Path.h>
+
+// Package: Threading
+#include <Poco/Thread.h>
+
+#include "DigestCache.h"
+#include "FileDigest.h"
+#include "Sha256Backend.h"
+#include "Stats.h"
+
+#if defined(POCO_OS_FAMILY_UNIX)
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+// Package: Filesystem
+#include <Poco/DirectoryIterator.h>
+#include <Poco/File.h>
+#endif
+
+namespace
+{
+    // Files hashed per task: enough to fill the lanes of a multi-buffer
+    // backend, few enough that a directory of large files still spreads out.
+    const std::size_t FILES_PER_TASK = 16;
+
+#if defined(POCO_OS_FAMILY_UNIX)
+    // Directories held open from listing them until their last task is done.
+    // Tasks are queued in order, so a whole level of the tree is outstanding
+    // at once; past the limit a directory is closed once listed, and its
+    // tasks open it again by path.
+    const int MAX_OPEN_DIRECTORIES = 256;
+
+    // How long a shortage of descriptors is waited out before it's an error.
+    const int OPEN_ATTEMPTS = 500;
+    const long OPEN_RETRY_MILLISECONDS = 10;
+
+    // A quarter of the descriptor limit, leaving the rest for the files being
+    // read and whatever else the process has open.
+    int DirectoryLimit()
+    {
+        struct rlimit limit;
+        if (::getrlimit(RLIMIT_NOFILE, &limit) != 0 || limit.rlim_cur == RLIM_INFINITY ||
+            limit.rlim_cur / 4 >= static_cast<rlim_t>(MAX_OPEN_DIRECTORIES))
+        {
+            return MAX_OPEN_DIRECTORIES;
+        }
+        return std::max(1, static_cast<int>(limit.rlim_cur / 4));
+    }
+
+    // openat() with O_CLOEXEC. Running out of descriptors is waited out, since
+    // other threads close theirs all the time; other errors return -1 at once.
+    int OpenAt(int directory, const char *name, int flags)
+    {
+#if defined(O_CLOEXEC)
+        flags |= O_CLOEXEC;
+#endif
+        for (int attempt = 1;; ++attempt)
+        {
+            const int fd = ::openat(directory, name, flags);
+            if (fd >= 0 || (errno != EMFILE && errno != ENFILE) || attempt == OPEN_ATTEMPTS)
+            {
+                return fd;
+            }
+            Poco::Thread::sleep(OPEN_RETRY_MILLISECONDS);
+        }
+    }
+#endif
+
+    bool NameLess(const std::unique_ptr<TreeWalker::Node> &a, const std::unique_ptr<TreeWalker::Node> &b)
+    {
+        return a->name < b->name;
+    }
+
+    bool Matches(std::vector<Poco::Glob> &patterns, const std::string &subject)
+    {
+        for (Poco::Glob &pattern : patterns)
+        {
+            if (pattern.match(subject))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+#if defined(POCO_OS_FAMILY_UNIX)
+    // Called from a catch block, like CaptureException(). Files are opened and
+    // read by name in their directory, so errors name only the entry; the
+    // path is put together here, once there's an error to report.
+    Poco::Exception *CaptureFileException(const std::string &pathName)
+    {
+        try
+        {
+            try
+            {
+                throw;
+            }
+            catch (const Poco::ReadFileException &e)
+            {
+                if (e.code() == 0)
+                {
+                    throw Poco::ReadFileException(pathName);
+                }
+                throw Poco::ReadFileException(pathName, std::strerror(e.code()), e.code());
+            }
+            catch (const Poco::FileException &e)
+            {
+                if (e.code() == 0)
+                {
+                    throw;
+                }
+                ThrowFileError(pathName, e.code());
+            }
+        }
+        catch (...)
+        {
+            return CaptureException();
+        }
+        return nullptr; // ThrowFileError() always throws
+    }
+#endif
+}
+
+class TreeWalker::DirectoryTask : public PoolTask
+{
+public:
+    DirectoryTask(TreeWalker &walker, Node &directory) : walker_(walker), directory_(directory) {}
+
+    void run() noexcept override
+    {
+        walker_.readDirectory(directory_);
+        walker_.tasks_.finish();
+    }
+
+private:
+    TreeWalker &walker_;
+    Node &directory_;
+};
+
+class TreeWalker::FilesTask : public PoolTask
+{
+public:
+    FilesTask(TreeWalker &walker, Node &directory, std::vector<Node *> &&files)
+        : walker_(walker), directory_(directory), files_(std::move(files))
+    {
+    }
+
+    void run() noexcept override
+    {
+        walker_.hashFiles(directory_, files_);
+        walker_.release(directory_);
+        walker_.tasks_.finish();
+    }
+
+private:
+    TreeWalker &walker_;
+    Node &directory_;
+    std::vector<Node *> files_;
+};
+
+TreeWalker::TreeWalker(Poco::NotificationQueue &queue, const Sha256Backend &backend, const FileReader &reader, DigestCache *cache, bool refreshCache)
+    : backend_(backend), reader_(reader), cache_(cache), refreshCache_(refreshCache), tasks_(queue)
+{
+#if defined(POCO_OS_FAMILY_UNIX)
+    directoryLimit_ = DirectoryLimit();
+#endif
+}
+
+TreeWalker::~TreeWalker()
+{
+}
+
+void TreeWalker::setStats(HashStats *stats)
+{
+    stats_ = stats;
+}
+
+void TreeWalker::include(const std::string &pattern)
+{
+    (pattern.find('/') == std::string::npos ? includeNames_ : includePaths_).push_back(Poco::Glob(pattern));
+}
+
+void TreeWalker::exclude(const std::string &pattern)
+{
+    (pattern.find('/') == std::string::npos ? excludeNames_ : excludePaths_).push_back(Poco::Glob(pattern));
+}
+
+void TreeWalker::walk(const std::string &root)
+{
+    rootPath_ = root;
+    root_.reset(new Node);
+    root_->isDirectory = true;
+
+    tasks_.enqueue(new DirectoryTask(*this, *root_));
+    tasks_.wait();
+}
+
+void TreeWalker::visit(const std::function<void(const std::string &, const Node &)> &visitor) const
+{
+    if (root_)
+    {
+        std::string path;
+        visit(*root_, path, visitor);
+    }
+}
+
+void TreeWalker::visit(const Node &node, std::string &path, const std::function<void(const std::string &, const Node &)> &visitor)
+{
+    if (!node.isDirectory || node.error)
+    {
+        visitor(path, node);
+        return;
+    }
+
+    // One buffer for the whole walk: each level appends its name and cuts it
+    // off again.
+    const std::size_t length = path.size();
+    for (const std::unique_ptr<Node> &child : node.children)
+    {
+        if (length > 0)
+        {
+            path += '/';
+        }
+        path += child->name;
+        visit(*child, path, visitor);
+        path.resize(length);
+    }
+}
+
+void TreeWalker::release(Node &directory)
+{
+    if (--directory.users == 0 && directory.fd >= 0)
+    {
+#if defined(POCO_OS_FAMILY_UNIX)
+        ::close(directory.fd);
+        --openDirectories_;
+#endif
+        directory.fd = -1;
+    }
+}
+
+// Lists a directory, then queues a task per subdirectory and one per run of
+// files. Sorting happens here too, on the worker, so printing is a plain walk.
+void TreeWalker::readDirectory(Node &directory)
+{
+    std::vector<Node *> files;
+    std::size_t subdirectories = 0;
+
+    try
+    {
+#if defined(POCO_OS_FAMILY_UNIX)
+        const int flags = O_RDONLY | O_DIRECTORY;
+        int fd = -1;
+        int error = 0;
+        if (directory.parent)
+        {
+            // A parent closed to stay under the limit is opened again by path.
+            Node &parent = *directory.parent;
+            FileDescriptor reopened(parent.fd < 0 ? OpenAt(AT_FDCWD, fullPath(parent).c_str(), flags) : -1);
+            const int parentFd = parent.fd < 0 ? reopened.get() : parent.fd;
+            fd = parentFd >= 0 ? OpenAt(parentFd, directory.name.c_str(), flags | O_NOFOLLOW) : -1;
+            error = errno;
+            release(parent);
+        }
+        else
+        {
+            fd = OpenAt(AT_FDCWD, rootPath_.c_str(), flags);
+            error = errno;
+        }
+        if (fd < 0)
+        {
+            ThrowFileError(fullPath(directory), error);
+        }
+        directory.fd = fd;
+        ++openDirectories_;
+
+        // readdir() owns the descriptor it's given and closes it with the
+        // stream; ours stays open for the tasks below.
+        const int listFd = OpenAt(fd, ".", flags);
+        DIR *list = listFd >= 0 ? ::fdopendir(listFd) : nullptr;
+        if (!list)
+        {
+            const int error = errno;
+            if (listFd >= 0)
+            {
+                ::close(listFd);
+            }
+            ThrowFileError(fullPath(directory), error);
+        }
+
+        while (struct dirent *entry = ::readdir(list))
+        {
+            const char *name = entry->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+            {
+                continue;
+            }
+
+            bool isDirectory = entry->d_type == DT_DIR;
+            bool isFile = entry->d_type == DT_REG;
+            if (entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK)
+            {
+                // Follow links, but only to files.
+                struct stat st;
+                if (::fstatat(fd, name, &st, 0) == 0)
+                {
+                    isFile = S_ISREG(st.st_mode);
+                    isDirectory = S_ISDIR(st.st_mode) && entry->d_type == DT_UNKNOWN &&
+                                  ::fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode);
+                }
+            }
+
+            if ((!isDirectory && !isFile) || isFilteredOut(directory, name, isDirectory))
+            {
+                continue;
+            }
+
+            std::unique_ptr<Node> child(new Node);
+            child->name = name;
+            child->parent = &directory;
+            child->isDirectory = isDirectory;
+            directory.children.push_back(std::move(child));
+        }
+        ::closedir(list);
+#else
+        Poco::Path path(rootPath_);
+        path.makeDirectory();
+        path.append(Poco::Path(relativePath(directory)).makeDirectory());
+        for (Poco::DirectoryIterator it(path), end; it != end; ++it)
+        {
+            const bool isDirectory = it->isDirectory() && !it->isLink();
+            if ((!isDirectory && !it->isFile()) || isFilteredOut(directory, it.name(), isDirectory))
+            {
+                continue;
+            }
+
+            std::unique_ptr<Node> child(new Node);
+            child->name = it.name();
+            child->parent = &directory;
+            child->isDirectory = isDirectory;
+            directory.children.push_back(std::move(child));
+        }
+#endif
+    }
+    catch (...)
+    {
+        directory.error = CaptureException();
+        directory.children.clear();
+        directory.users = 1;
+        release(directory);
+        return;
+    }
+
+    std::sort(directory.children.begin(), directory.children.end(), NameLess);
+
+    for (const std::unique_ptr<Node> &child : directory.children)
+    {
+        if (child->isDirectory)
+        {
+            ++subdirectories;
+        }
+        else
+        {
+            files.push_back(child.get());
+        }
+    }
+
+    // Count every task before queueing any, or the first to finish could
+    // close the directory under the rest.
+    const std::size_t fileTasks = (files.size() + FILES_PER_TASK - 1) / FILES_PER_TASK;
+    directory.users = static_cast<int>(subdirectories + fileTasks);
+    if (subdirectories + fileTasks == 0)
+    {
+        // Nothing below needs the directory open.
+        directory.users = 1;
+        release(directory);
+        return;
+    }
+
+#if defined(POCO_OS_FAMILY_UNIX)
+    if (openDirectories_ > directoryLimit_)
+    {
+        ::close(directory.fd);
+        --openDirectories_;
+        directory.fd = -1;
+    }
+#endif
+
+    for (const std::unique_ptr<Node> &child : directory.children)
+    {
+        if (child->isDirectory)
+        {
+            tasks_.enqueue(new DirectoryTask(*this, *child));
+        }
+    }
+    for (std::size_t first = 0; first < files.size(); first += FILES_PER_TASK)
+    {
+        const std::size_t last = std::min(first + FILES_PER_TASK, files.size());
+        tasks_.enqueue(new FilesTask(*this, directory, std::vector<Node *>(files.begin() + first, files.begin() + last)));
+    }
+}
+
+void TreeWalker::hashFiles(Node &directory, const std::vector<Node *> &files)
+{
+    // Small files collected for one multi-buffer pass at the end.
+    struct SmallFile
+    {
+        Node *node;
+        bool cacheable;
+        DigestCache::Key key;
+        HashStats::Timer timer;
+    };
+    std::vector<SmallFile> small;
+    std::vector<std::string> contents;
+    const bool multiBuffer = backend_.lanes() > 1 && files.size() > 1;
+    const bool useCache = cache_ && cache_->isOpen();
+#if defined(POCO_OS_FAMILY_UNIX)
+    // A directory closed to stay under the limit is opened again by path.
+    FileDescriptor reopened(directory.fd < 0 ? OpenAt(AT_FDCWD, fullPath(directory).c_str(), O_RDONLY | O_DIRECTORY) : -1);
+    const int directoryFd = directory.fd < 0 ? reopened.get() : directory.fd;
+    const int directoryError = errno;
+#endif
+
+    for (Node *file : files)
+    {
+        const HashStats::Timer timer;
+        try
+        {
+#if defined(POCO_OS_FAMILY_UNIX)
+            const int descriptor = directoryFd >= 0 ? OpenAt(directoryFd, file->name.c_str(), O_RDONLY) : -1;
+            if (descriptor < 0)
+            {
+                ThrowFileError(file->name, directoryFd >= 0 ? errno : directoryError);
+            }
+            FileDescriptor fd(descriptor);
+
+            DigestCache::Key key;
+            bool cacheable = useCache && DigestCache::keyFor(fd.get(), key);
+            if (cacheable && !refreshCache_ && cache_->lookup(key, file->digest))
+            {
+                if (stats_)
+                {
+                    stats_->recordCacheHit(timer.elapsed());
+                }
+                continue;
+            }
+
+            std::string data;
+            if (multiBuffer && ReadSmallDescriptor(fd.get(), file->name, MULTI_BUFFER_FILE_LIMIT, data))
+            {
+                // Only remember the digest if the file didn't change while read.
+                DigestCache::Key after;
+                cacheable = cacheable && DigestCache::keyFor(fd.get(), after) && after == key;
+
+                SmallFile entry = {file, cacheable, key, timer};
+                small.push_back(entry);
+                contents.push_back(std::move(data));
+                continue;
+            }
+
+            Sha256Engine engine(backend_);
+            DigestDescriptor(fd.get(), file->name, engine, reader_);
+            const Poco::UInt64 length = engine.length();
+            file->digest = engine.digest();
+            if (stats_)
+            {
+                stats_->recordFile(length, timer.elapsed());
+            }
+
+            DigestCache::Key after;
+            if (cacheable && DigestCache::keyFor(fd.get(), after) && after == key)
+            {
+                cache_->store(key, file->digest);
+            }
+#else
+            (void)useCache;
+            Poco::Path path(rootPath_);
+            path.makeDirectory();
+            path.append(relativePath(*file));
+
+            std::string data;
+            if (multiBuffer && ReadSmallFile(path.toString(), MULTI_BUFFER_FILE_LIMIT, data))
+            {
+                SmallFile entry = {file, false, DigestCache::Key(), timer};
+                small.push_back(entry);
+                contents.push_back(std::move(data));
+                continue;
+            }
+
+            Sha256Engine engine(backend_);
+            DigestFile(path.toString(), engine, reader_);
+            const Poco::UInt64 length = engine.length();
+            file->digest = engine.digest();
+            if (stats_)
+            {
+                stats_->recordFile(length, timer.elapsed());
+            }
+#endif
+        }
+        catch (...)
+        {
+#if defined(POCO_OS_FAMILY_UNIX)
+            file->error = CaptureFileException(fullPath(*file));
+#else
+            file->error = CaptureException();
+#endif
+            if (stats_)
+            {
+                stats_->recordError();
+            }
+        }
+    }
+
+    if (!small.empty())
+    {
+        std::vector<Poco::DigestEngine::Digest> digests;
+        Sha256DigestMany(backend_, contents, digests);
+        for (std::size_t i = 0; i < small.size(); ++i)
+        {
+            small[i].node->digest = digests[i];
+            if (stats_)
+            {
+                stats_->recordFile(contents[i].size(), small[i].timer.elapsed());
+            }
+            if (small[i].cacheable)
+            {
+                cache_->store(small[i].key, digests[i]);
+            }
+        }
+    }
+}
+
+// A path is only built when there's a pattern with a slash to match it against.
+bool TreeWalker::isFilteredOut(const Node &directory, const std::string &name, bool isDirectory) const
+{
+    if (Matches(excludeNames_, name))
+    {
+        return true;
+    }
+    if (!isDirectory && !includeNames_.empty() && includePaths_.empty() && !Matches(includeNames_, name))
+    {
+        return true;
+    }
+    if (excludePaths_.empty() && (isDirectory || includePaths_.empty()))
+    {
+        return false;
+    }
+
+    std::string path(relativePath(directory));
+    if (!path.empty())
+    {
+        path += '/';
+    }
+    path += name;
+
+    if (Matches(excludePaths_, path))
+    {
+        return true;
+    }
+    return !isDirectory && !includePaths_.empty() && !Matches(includeNames_, name) && !Matches(includePaths_, path);
+}
+
+std::string TreeWalker::fullPath(const Node &node) const
+{
+    std::string path(rootPath_);
+    const std::string relative(relativePath(node));
+    if (!relative.empty())
+    {
+        if (!path.empty())
+        {
+            path += '/';
+        }
+        path += relative;
+    }
+    return path;
+}
+
+std::string TreeWalker::relativePath(const Node &node)
+{
+    std::vector<const Node *> chain;
+    for (const Node *n = &node; n->parent; n = n->parent)
+    {
+        chain.push_back(n);
+    }
+
+    std::string path;
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+    {
+        if (!path.empty())
+        {
+            path += '/';
+        }
+        path += (*it)->name;
+    }
+    return path;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Package: Core
+#include <Poco/AtomicCounter.h>
+#include <Poco/Exception.h>
+#include <Poco/Foundation.h>
+#include <Poco/SharedPtr.h>
+
+// Package: Crypt
+#include <Poco/DigestEngine.h>
+
+// Package: Filesystem
+#include <Poco/Glob.h>
+
+// Package: Threading
+#include <Poco/NotificationQueue.h>
+
+#include "PoolTask.h"
+
+class DigestCache;
+class FileReader;
+class HashStats;
+class Sha256Backend;
+
+// Hashes every file under a directory.
+//
+// Reading a directory and hashing a run of its files are both PoolTasks, so
+// the workers that hash command line files walk the tree too, and the thread
+// calling walk() pitches in until it's done. On Unix each
+// directory is opened relative to its parent with openat() and read with
+// readdir(), so the walk seldom builds a full path: a node holds only its own
+// name, and paths are put together while printing, for an error, or to open
+// a directory again when too many were open to keep it.
+//
+// Symbolic links to files are hashed; links to directories aren't followed, so
+// the walk can't loop. Sockets, FIFOs and devices are skipped.
+class TreeWalker
+{
+public:
+    struct Node
+    {
+        std::string name;
+        Node *parent = nullptr;
+        bool isDirectory = false;
+        std::vector<std::unique_ptr<Node>> children; // sorted by name
+        Poco::DigestEngine::Digest digest;
+        Poco::SharedPtr<Poco::Exception> error;
+
+        // A directory stays open while tasks for its entries are outstanding,
+        // unless too many are open already; then it's -1.
+        int fd = -1;
+        Poco::AtomicCounter users;
+    };
+
+    TreeWalker(Poco::NotificationQueue &queue, const Sha256Backend &backend, const FileReader &reader, DigestCache *cache, bool refreshCache);
+    ~TreeWalker();
+
+    // Glob patterns. One containing a slash is matched against the path below
+    // the root, anything else against the entry's name. Excluded directories
+    // aren't entered; once there's an include pattern, only files matching one
+    // are hashed.
+    void include(const std::string &pattern);
+    void exclude(const std::string &pattern);
+
+    // Counts every file hashed into `stats`, if not null.
+    void setStats(HashStats *stats);
+
+    // Hashes everything under root. Errors are recorded on the nodes.
+    void walk(const std::string &root);
+
+    // Calls visitor with the path below the root of every file, and of every
+    // directory that couldn't be read, depth first in name order.
+    void visit(const std::function<void(const std::string &, const Node &)> &visitor) const;
+
+private:
+    TreeWalker(const TreeWalker &);
+    TreeWalker &operator=(const TreeWalker &);
+
+    class DirectoryTask;
+    class FilesTask;
+
+    void release(Node &directory);
+
+    void readDirectory(Node &directory);
+    void hashFiles(Node &directory, const std::vector<Node *> &files);
+
+    bool isFilteredOut(const Node &directory, const std::string &name, bool isDirectory) const;
+    static std::string relativePath(const Node &node);
+    std::string fullPath(const Node &node) const; // under the root as given to walk()
+    static void visit(const Node &node, std::string &path, const std::function<void(const std::string &, const Node &)> &visitor);
+
+    const Sha256Backend &backend_;
+    const FileReader &reader_;
+    DigestCache *cache_;
+    bool refreshCache_;
+    HashStats *stats_ = nullptr;
+
+    // Glob::match() isn't const, though it doesn't modify anything.
+    mutable std::vector<Poco::Glob> includeNames_;
+    mutable std::vector<Poco::Glob> includePaths_;
+    mutable std::vector<Poco::Glob> excludeNames_;
+    mutable std::vector<Poco::Glob> excludePaths_;
+
+    Poco::AtomicCounter openDirectories_;
+    int directoryLimit_ = 0;
+
+    std::string rootPath_;
+    std::unique_ptr<Node> root_;
+    TaskGroup tasks_;
+};
@@ -0,0 +1,480 @@
+// Package: Application
+#include <Poco/Util/Application.h>
+
+// Package: Core
+#include <Poco/AtomicCounter.h>
+#include <Poco/Environment.h>
+#include <Poco/NumberFormatter.h>
+#include <Poco/NumberParser.h>
+#include <Poco/SharedPtr.h>
+#include <Poco/StringTokenizer.h>
+
+// Package: Crypt
+#include <Poco/DigestEngine.h>
+#include <Poco/SHA2Engine.h>
+
+// Package: Filesystem
+#include <Poco/File.h>
+#include <Poco/Path.h>
+#include <Poco/TemporaryFile.h>
+
+// Package: Options
+#include <Poco/Util/HelpFormatter.h>
+#include <Poco/Util/IntValidator.h>
+#include <Poco/Util/Option.h>
+#include <Poco/Util/OptionException.h>
+#include <Poco/Util/OptionSet.h>
+
+// Package: Streams
+#include <Poco/FileStream.h>
+
+// Package: Threading
+#include <Poco/Runnable.h>
+#include <Poco/ThreadPool.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined(POCO_OS_FAMILY_UNIX)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "FileDigest.h"
+#include "FileReader.h"
+#include "Sha256Backend.h"
+#include "Stats.h"
+
+// A synthetic file set: `count` files whose sizes step evenly (on a log scale
+// when `logScale`) from `minimum` to `maximum` bytes.
+struct FileSet
+{
+    const char *name;
+    unsigned count;
+    Poco::UInt64 minimum;
+    Poco::UInt64 maximum;
+    bool logScale;
+};
+
+static const FileSet FILE_SETS[] = {
+    {"tiny", 20000, 64, 4 * 1024, false},
+    {"huge", 4, 256 * 1024 * 1024, 256 * 1024 * 1024, false},
+    {"mixed", 2000, 1024, 64 * 1024 * 1024, true},
+};
+
+// Generates file sets and hashes them with every combination of I/O engine and
+// SHA-256 backend, the way sha256sum itself does: small files are read whole
+// and hashed lanes() at a time, the rest stream through their own engine.
+class Bench : public Poco::Util::Application
+{
+private:
+    void defineOptions(Poco::Util::OptionSet &options) override
+    {
+        Poco::Util::Application::defineOptions(options);
+
+        options.addOption(
+            Poco::Util::Option("set", "", "file set to run: tiny (default), huge, mixed or all")
+                .argument("NAME"));
+        options.addOption(
+            Poco::Util::Option("jobs", "j", "hash on N threads (default: one per processor)")
+                .argument("N")
+                .validator(new Poco::Util::IntValidator(1, 1024)));
+        options.addOption(
+            Poco::Util::Option("io", "", "comma separated I/O engines to run (default: all)")
+                .argument("LIST"));
+        options.addOption(
+            Poco::Util::Option("backend", "", "comma separated SHA-256 backends to run (default: all this CPU supports)")
+                .argument("LIST"));
+        options.addOption(
+            Poco::Util::Option("dir", "", "generate the files below DIR and reuse them on later runs (default: a temporary directory)")
+                .argument("DIR"));
+        options.addOption(
+            Poco::Util::Option("scale", "", "multiply file counts by PERCENT/100 (default 100)")
+                .argument("PERCENT")
+                .validator(new Poco::Util::IntValidator(1, 10000)));
+        options.addOption(Poco::Util::Option("keep", "", "don't delete the generated files (always kept with --dir)"));
+        options.addOption(Poco::Util::Option("cold", "", "ask the kernel to drop each file from the page cache before every run"));
+        options.addOption(Poco::Util::Option("help", "", "display this help and exit."));
+    }
+
+    void handleOption(const std::string &name, const std::string &value) override
+    {
+        Poco::Util::Application::handleOption(name, value);
+
+        if (name == "set")
+        {
+            arg_set = value;
+        }
+        else if (name == "jobs")
+        {
+            arg_jobs = Poco::NumberParser::parseUnsigned(value);
+        }
+        else if (name == "io")
+        {
+            arg_io = value;
+        }
+        else if (name == "backend")
+        {
+            arg_backend = value;
+        }
+        else if (name == "dir")
+        {
+            arg_dir = value;
+        }
+        else if (name == "scale")
+        {
+            arg_scale = Poco::NumberParser::parseUnsigned(value);
+        }
+        else if (name == "keep")
+        {
+            arg_keep = true;
+        }
+        else if (name == "cold")
+        {
+            arg_cold = true;
+        }
+        else if (name == "help")
+        {
+            arg_help = true;
+        }
+    }
+
+    int main(const std::vector<std::string> &arguments) override;
+
+    // Hashes files[i] for every i it takes off `next`, into digests[i].
+    class Worker : public Poco::Runnable
+    {
+    public:
+        Worker(Bench &bench, const Sha256Backend &backend, const FileReader &reader, HashStats &stats)
+            : bench_(bench), backend_(backend), reader_(reader), stats_(stats)
+        {
+        }
+
+        void run() override;
+
+    private:
+        void flush();
+
+        Bench &bench_;
+        const Sha256Backend &backend_;
+        const FileReader &reader_;
+        HashStats &stats_;
+
+        std::vector<std::size_t> small_;
+        std::vector<std::string> contents_;
+        std::vector<HashStats::Timer> timers_;
+    };
+
+    static std::vector<std::string> SplitList(const std::string &list, const std::vector<std::string> &all);
+    void Generate(const FileSet &set, const Poco::Path &directory);
+    void Reference();
+    void DropCache() const;
+    bool Run(const FileSet &set, const Sha256Backend &backend, const FileReader &reader);
+
+    std::string arg_set = "tiny";
+    unsigned arg_jobs = 0;
+    std::string arg_io;
+    std::string arg_backend;
+    std::string arg_dir;
+    unsigned arg_scale = 100;
+    bool arg_keep = false;
+    bool arg_cold = false;
+    bool arg_help = false;
+
+    std::vector<std::string> files_;
+    std::vector<Poco::DigestEngine::Digest> digests_;
+    std::vector<Poco::DigestEngine::Digest> expected_;
+    Poco::AtomicCounter next_;
+    Poco::AtomicCounter failed_;
+};
+
+void Bench::Worker::run()
+{
+    const std::size_t count = bench_.files_.size();
+    for (;;)
+    {
+        const std::size_t i = static_cast<std::size_t>(++bench_.next_ - 1);
+        if (i >= count)
+        {
+            break;
+        }
+
+        const HashStats::Timer timer;
+        const std::string &pathName = bench_.files_[i];
+        try
+        {
+            std::string data;
+            if (backend_.lanes() > 1 && ReadSmallFile(pathName, MULTI_BUFFER_FILE_LIMIT, data))
+            {
+                small_.push_back(i);
+                contents_.push_back(std::move(data));
+                timers_.push_back(timer);
+                if (small_.size() == backend_.lanes())
+                {
+                    flush();
+                }
+                continue;
+            }
+
+            Sha256Engine engine(backend_);
+            DigestFile(pathName, engine, reader_);
+            const Poco::UInt64 length = engine.length();
+            bench_.digests_[i] = engine.digest();
+            stats_.recordFile(length, timer.elapsed());
+        }
+        catch (const Poco::Exception &e)
+        {
+            std::cerr << e.displayText() << std::endl;
+            stats_.recordError();
+            ++bench_.failed_;
+        }
+    }
+    flush();
+}
+
+void Bench::Worker::flush()
+{
+    if (small_.empty())
+    {
+        return;
+    }
+
+    std::vector<Poco::DigestEngine::Digest> digests;
+    Sha256DigestMany(backend_, contents_, digests);
+    for (std::size_t j = 0; j < small_.size(); ++j)
+    {
+        bench_.digests_[small_[j]] = digests[j];
+        stats_.recordFile(contents_[j].size(), timers_[j].elapsed());
+    }
+    small_.clear();
+    contents_.clear();
+    timers_.clear();
+}
+
+// Names from a comma separated list, or all of them if it's empty.
+std::vector<std::string> Bench::SplitList(const std::string &list, const std::vector<std::string> &all)
+{
+    if (list.empty())
+    {
+        return all;
+    }
+
+    Poco::StringTokenizer tokens(list, ",", Poco::StringTokenizer::TOK_TRIM | Poco::StringTokenizer::TOK_IGNORE_EMPTY);
+    return std::vector<std::string>(tokens.begin(), tokens.end());
+}
+
+// Writes the set's files with xorshift noise, so neither the file system nor
+// the storage below it can compress or deduplicate them.
+void Bench::Generate(const FileSet &set, const Poco::Path &directory)
+{
+    Poco::File(directory).createDirectories();
+
+    const unsigned count = std::max(1u, static_cast<unsigned>(static_cast<Poco::UInt64>(set.count) * arg_scale / 100));
+    const double ratio = count > 1 ? static_cast<double>(set.maximum) / set.minimum : 1;
+
+    Poco::UInt64 state = 0x9E3779B97F4A7C15ULL;
+    std::vector<char> block(64 * 1024);
+    files_.clear();
+    for (unsigned i = 0; i < count; ++i)
+    {
+        const double position = count > 1 ? static_cast<double>(i) / (count - 1) : 0;
+        const Poco::UInt64 size = set.logScale
+                                      ? static_cast<Poco::UInt64>(set.minimum * std::pow(ratio, position))
+                                      : set.minimum + static_cast<Poco::UInt64>((set.maximum - set.minimum) * position);
+
+        Poco::Path path(directory, Poco::NumberFormatter::format0(i, 6));
+        files_.push_back(path.toString());
+
+        Poco::File file(path);
+        if (file.exists() && file.getSize() == size)
+        {
+            continue;
+        }
+
+        Poco::FileOutputStream out(path.toString(), std::ios::binary | std::ios::trunc);
+        for (Poco::UInt64 written = 0; written < size;)
+        {
+            for (std::size_t k = 0; k + 8 <= block.size(); k += 8)
+            {
+                state ^= state << 13;
+                state ^= state >> 7;
+                state ^= state << 17;
+                std::memcpy(&block[k], &state, 8);
+            }
+            const std::size_t n = static_cast<std::size_t>(std::min<Poco::UInt64>(block.size(), size - written));
+            out.write(block.data(), static_cast<std::streamsize>(n));
+            written += n;
+        }
+        out.close();
+    }
+}
+
+// Digests of the files from Poco's own SHA-256 and a plain stream, so a bug in
+// a backend or I/O engine shows even when it's the only one run.
+void Bench::Reference()
+{
+    expected_.clear();
+    std::vector<char> buffer(64 * 1024);
+    for (const std::string &pathName : files_)
+    {
+        Poco::SHA2Engine engine(Poco::SHA2Engine::SHA_256);
+        Poco::FileInputStream in(pathName, std::ios::binary);
+        for (;;)
+        {
+            in.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            if (in.gcount() <= 0)
+            {
+                break;
+            }
+            engine.update(buffer.data(), static_cast<std::size_t>(in.gcount()));
+        }
+        expected_.push_back(engine.digest());
+    }
+}
+
+// Only clean pages are dropped, so the files are flushed first.
+void Bench::DropCache() const
+{
+#if defined(POCO_OS_FAMILY_UNIX)
+    for (const std::string &pathName : files_)
+    {
+        const int fd = open(pathName.c_str(), O_RDONLY);
+        if (fd >= 0)
+        {
+            fdatasync(fd);
+            posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            close(fd);
+        }
+    }
+#endif
+}
+
+// Hashes the set once, checks the digests against Reference() and prints a row.
+bool Bench::Run(const FileSet &set, const Sha256Backend &backend, const FileReader &reader)
+{
+    if (arg_cold)
+    {
+        DropCache();
+    }
+
+    digests_.assign(files_.size(), Poco::DigestEngine::Digest());
+    next_ = 0;
+    failed_ = 0;
+
+    HashStats stats;
+    std::vector<Poco::SharedPtr<Worker>> workers;
+    Poco::ThreadPool pool(1, static_cast<int>(arg_jobs));
+    const HashStats::Timer timer;
+    for (unsigned i = 0; i < arg_jobs; ++i)
+    {
+        Poco::SharedPtr<Worker> worker(new Worker(*this, backend, reader, stats));
+        workers.push_back(worker);
+        pool.start(*worker);
+    }
+    pool.joinAll();
+    const double seconds = timer.elapsed() / 1e9;
+
+    const bool matched = failed_ == 0 && digests_ == expected_;
+
+    const std::ios::fmtflags flags(std::cout.flags());
+    std::cout << std::left << std::setw(7) << set.name << std::setw(11) << reader.name() << std::setw(8) << backend.name()
+              << std::right << std::fixed << std::setprecision(1)
+              << std::setw(10) << stats.bytes() / seconds / (1024 * 1024)
+              << std::setw(11) << stats.files() / seconds
+              << std::setw(10) << stats.percentile(0.50) / 1000.0
+              << std::setw(11) << stats.percentile(0.99) / 1000.0
+              << (matched ? "" : "  MISMATCH") << std::endl;
+    std::cout.flags(flags);
+    return matched;
+}
+
+int Bench::main(const std::vector<std::string> &arguments)
+{
+    if (arg_help || !arguments.empty())
+    {
+        Poco::Util::HelpFormatter formatter(options());
+        formatter.setCommand(commandName());
+        formatter.setUsage("[OPTION]...");
+        formatter.format(std::cout);
+        return arg_help ? EXIT_OK : EXIT_USAGE;
+    }
+
+    if (arg_jobs == 0)
+    {
+        arg_jobs = Poco::Environment::processorCount();
+    }
+
+    std::vector<const FileSet *> sets;
+    for (const FileSet &set : FILE_SETS)
+    {
+        if (arg_set == "all" || arg_set == set.name)
+        {
+            sets.push_back(&set);
+        }
+    }
+
+    std::vector<const Sha256Backend *> backends;
+    std::vector<const FileReader *> readers;
+    try
+    {
+        if (sets.empty())
+        {
+            throw Poco::Util::InvalidArgumentException("unknown file set", arg_set);
+        }
+        for (const std::string &name : SplitList(arg_backend, Sha256Backend::available()))
+        {
+            backends.push_back(&Sha256Backend::select(name));
+        }
+        for (const std::string &name : SplitList(arg_io, FileReader::available()))
+        {
+            readers.push_back(&FileReader::select(name));
+        }
+    }
+    catch (const Poco::InvalidArgumentException &e)
+    {
+        std::cerr << commandName() << ": " << e.displayText() << std::endl;
+        return EXIT_USAGE;
+    }
+
+    // Removes whatever was generated when it goes, even if generating or
+    // hashing throws, e.g. when the disk fills up.
+    const bool temporary = arg_dir.empty();
+    Poco::TemporaryFile temporaryRoot;
+    if (!temporary || arg_keep)
+    {
+        temporaryRoot.keep();
+    }
+    const Poco::Path root(temporary ? temporaryRoot.path() : arg_dir);
+
+    std::cout << "set    io         backend      MB/s    files/s   p50 us     p99 us" << std::endl;
+    bool matched = true;
+    for (const FileSet *set : sets)
+    {
+        const Poco::Path directory(root, set->name);
+        Generate(*set, directory);
+        Reference();
+
+        for (const FileReader *reader : readers)
+        {
+            for (const Sha256Backend *backend : backends)
+            {
+                matched = Run(*set, *backend, *reader) && matched;
+            }
+        }
+
+        // One set on disk at a time.
+        if (temporary && !arg_keep)
+        {
+            Poco::File(directory).remove(true);
+        }
+    }
+
+    return matched ? EXIT_OK : EXIT_SOFTWARE;
+}
+
+POCO_APP_MAIN(Bench)
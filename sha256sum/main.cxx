@@ -8,12 +8,16 @@
 #include <Poco/Util/SystemConfiguration.h>
 
 // Package: Core
+#include <Poco/Ascii.h>
+#include <Poco/Environment.h>
 #include <Poco/NestedDiagnosticContext.h>
+#include <Poco/NumberFormatter.h>
+#include <Poco/NumberParser.h>
+#include <Poco/SharedPtr.h>
 #include <Poco/String.h>
 
 // Package: Crypt
-#include <Poco/DigestStream.h>
-#include <Poco/SHA2Engine.h>
+#include <Poco/DigestEngine.h>
 
 // Package: Filesystem
 #include <Poco/File.h>
@@ -28,11 +32,62 @@
 #include <Poco/Util/Option.h>
 #include <Poco/Util/OptionCallback.h>
 #include <Poco/Util/OptionSet.h>
+#include <Poco/Util/IntValidator.h>
+#include <Poco/Util/OptionException.h>
 
 // Package: Streams
 #include <Poco/FileStream.h>
-#include <Poco/NullStream.h>
-#include <Poco/StreamCopier.h>
+
+// Package: Threading
+#include <Poco/Event.h>
+#include <Poco/Notification.h>
+#include <Poco/NotificationQueue.h>
+#include <Poco/Runnable.h>
+#include <Poco/ThreadPool.h>
+
+#include "AsyncLogChannel.h"
+#include "ChunkedDigest.h"
+#include "DigestCache.h"
+#include "FileDigest.h"
+#include "FileReader.h"
+#include "PoolTask.h"
+#include "Sha256Backend.h"
+#include "Stats.h"
+#include "TreeWalker.h"
+
+// One file's worth of work. A worker fills in the digest (or the error) and
+// signals done; the main thread prints jobs in the order they were queued.
+struct HashJob
+{
+    std::string pathName;
+    std::string message; // printed as-is, nothing to hash
+    bool isDirectory = false;
+    bool dispatched = false; // main thread only
+    Poco::DigestEngine::Digest expected; // --check only
+    Poco::UInt64 chunkSize = 0; // hashed as a Merkle tree of chunks this size
+    bool isRange = false; // only `length` bytes from `offset`, --check only
+    Poco::UInt64 offset = 0;
+    Poco::UInt64 length = 0; // also the size of a chunked file once hashed
+    Poco::DigestEngine::Digest digest;
+    std::vector<Poco::DigestEngine::Digest> chunks; // --chunks
+    Poco::SharedPtr<Poco::Exception> error;
+    Poco::Event done;
+};
+
+// Jobs handed to a worker together, so multi-buffer backends can hash small
+// files side by side.
+typedef std::vector<Poco::SharedPtr<HashJob>> HashBatch;
+
+class HashNotification : public Poco::Notification
+{
+public:
+    HashNotification(const HashBatch &batch) : batch_(batch) {}
+
+    const HashBatch &batch() const { return batch_; }
+
+private:
+    HashBatch batch_;
+};
 
 class Application : public Poco::Util::Application
 {
@@ -44,6 +99,36 @@ private:
         options.addOption(Poco::Util::Option("binary", "b", "read in binary mode"));
         options.addOption(Poco::Util::Option("check", "c", "read SHA256 sums from the FILEs and check them"));
         options.addOption(Poco::Util::Option("tag", "", "create a BSD-style checksum"));
+        options.addOption(Poco::Util::Option("quiet", "", "with --check, don't print OK for each successfully verified file"));
+        options.addOption(Poco::Util::Option("status", "", "with --check, don't output anything, status code shows success"));
+        options.addOption(
+            Poco::Util::Option("jobs", "j", "hash up to N files in parallel (0: one per processor)")
+                .argument("N")
+                .validator(new Poco::Util::IntValidator(0, 1024)));
+        options.addOption(Poco::Util::Option("cache", "", "remember digests of unchanged files between runs"));
+        options.addOption(Poco::Util::Option("no-cache", "", "don't use the digest cache, even if the configuration enables it"));
+        options.addOption(Poco::Util::Option("refresh", "", "rehash every file and rewrite its digest cache entry"));
+        options.addOption(
+            Poco::Util::Option("backend", "", "SHA-256 implementation: auto (default), shani, avx2 or scalar")
+                .argument("NAME"));
+        options.addOption(
+            Poco::Util::Option("io", "", "how files are read: auto (default, mmap), mmap, read, readahead or uring")
+                .argument("NAME"));
+        options.addOption(Poco::Util::Option("recursive", "r", "hash every file below the directories given"));
+        options.addOption(
+            Poco::Util::Option("include", "", "with --recursive, only hash files matching PATTERN")
+                .argument("PATTERN")
+                .repeatable(true));
+        options.addOption(
+            Poco::Util::Option("exclude", "", "with --recursive, skip files and directories matching PATTERN")
+                .argument("PATTERN")
+                .repeatable(true));
+        options.addOption(Poco::Util::Option("chunked", "", "hash each FILE as a Merkle tree of chunks, spread over all jobs"));
+        options.addOption(
+            Poco::Util::Option("chunk-size", "", "with --chunked, bytes per chunk, optionally suffixed K, M or G (default 4M)")
+                .argument("SIZE"));
+        options.addOption(Poco::Util::Option("chunks", "", "with --chunked, also print the SHA256 of every chunk"));
+        options.addOption(Poco::Util::Option("stats", "", "print throughput and per-file latency to stderr at the end"));
         options.addOption(Poco::Util::Option("help", "", "display this help and exit."));
     }
 
@@ -63,6 +148,70 @@ private:
         {
             arg_tag = true;
         }
+        else if (name == "quiet")
+        {
+            arg_quiet = true;
+        }
+        else if (name == "status")
+        {
+            arg_status = true;
+        }
+        else if (name == "jobs")
+        {
+            arg_jobs = Poco::NumberParser::parseUnsigned(value);
+            if (arg_jobs == 0)
+            {
+                arg_jobs = Poco::Environment::processorCount();
+            }
+        }
+        else if (name == "cache")
+        {
+            arg_cache = true;
+        }
+        else if (name == "no-cache")
+        {
+            arg_no_cache = true;
+        }
+        else if (name == "refresh")
+        {
+            arg_refresh = true;
+        }
+        else if (name == "backend")
+        {
+            arg_backend = value;
+        }
+        else if (name == "io")
+        {
+            arg_io = value;
+        }
+        else if (name == "recursive")
+        {
+            arg_recursive = true;
+        }
+        else if (name == "include")
+        {
+            arg_include.push_back(value);
+        }
+        else if (name == "exclude")
+        {
+            arg_exclude.push_back(value);
+        }
+        else if (name == "chunked")
+        {
+            arg_chunked = true;
+        }
+        else if (name == "chunk-size")
+        {
+            arg_chunk_size = ParseSize(value);
+        }
+        else if (name == "chunks")
+        {
+            arg_chunks = true;
+        }
+        else if (name == "stats")
+        {
+            arg_stats = true;
+        }
         else if (name == "help")
         {
             arg_help = true;
@@ -71,6 +220,57 @@ private:
 
     int main(const std::vector<std::string> &arguments) override;
 
+    void uninitialize() override
+    {
+        if (logChannel_)
+        {
+            logChannel_->close();
+        }
+        Poco::Util::Application::uninitialize();
+    }
+
+    static Poco::UInt64 ParseSize(const std::string &value)
+    {
+        Poco::UInt64 multiplier = 1;
+        std::string digits(value);
+        if (!digits.empty())
+        {
+            switch (Poco::Ascii::toUpper(digits[digits.size() - 1]))
+            {
+            case 'K':
+                multiplier = 1024;
+                break;
+            case 'M':
+                multiplier = 1024 * 1024;
+                break;
+            case 'G':
+                multiplier = 1024 * 1024 * 1024;
+                break;
+            }
+            if (multiplier > 1)
+            {
+                digits.erase(digits.size() - 1);
+            }
+        }
+
+        // Checked before multiplying, so the product can't overflow.
+        Poco::UInt64 size = 0;
+        if (!Poco::NumberParser::tryParseUnsigned64(digits, size) || size > MAX_CHUNK_SIZE / multiplier || !IsChunkSize(size * multiplier))
+        {
+            throw Poco::Util::InvalidArgumentException("chunk size must be between 4K and 1024G", value);
+        }
+        return size * multiplier;
+    }
+
+    // Smaller chunks only add tasks and tree nodes.
+    static bool IsChunkSize(Poco::UInt64 size)
+    {
+        return size >= MIN_CHUNK_SIZE && size <= MAX_CHUNK_SIZE;
+    }
+
+    static const Poco::UInt64 MIN_CHUNK_SIZE = 4096;
+    static const Poco::UInt64 MAX_CHUNK_SIZE = Poco::UInt64(1) << 40;
+
     // Command line args
 
     void ShowHelpMessage() const noexcept
@@ -81,14 +281,107 @@ private:
         formatter.format(std::cout);
     }
 
+    // Pulls HashJobs and PoolTasks off the queue until it dequeues any
+    // other notification.
+    class HashWorker : public Poco::Runnable
+    {
+    public:
+        HashWorker(Application &app, Poco::NotificationQueue &queue) : app_(app), queue_(queue) {}
+
+        void run() override
+        {
+            for (;;)
+            {
+                Poco::AutoPtr<Poco::Notification> notification(queue_.waitDequeueNotification());
+                if (HashNotification *work = dynamic_cast<HashNotification *>(notification.get()))
+                {
+                    app_.ComputeHashes(work->batch());
+                }
+                else if (PoolTask *task = dynamic_cast<PoolTask *>(notification.get()))
+                {
+                    task->run();
+                }
+                else
+                {
+                    break;
+                }
+            }
+        }
+
+    private:
+        Application &app_;
+        Poco::NotificationQueue &queue_;
+    };
+
     std::vector<std::string> ExpandFileArgument(const std::string &file);
-    void DisplayHash(const std::string &file);
+    void SubmitJob(const Poco::SharedPtr<HashJob> &job);
+    void ComputeChunked(HashJob &job) noexcept;
+    void DispatchBatch();
+    void FlushJobs(std::size_t keep);
+    void StopWorkers(Poco::ThreadPool &pool, std::size_t count);
+    void ComputeHashes(const HashBatch &batch) const noexcept;
+    void CacheDigest(const std::string &pathName, const DigestCache::Key &key, const Poco::DigestEngine::Digest &digest) const;
+    void DisplayHash(const HashJob &job);
+    void DisplayDigest(const Poco::DigestEngine::Digest &digest, const std::string &name) const;
+    bool IsDirectory(const std::string &pathName) const noexcept;
+    void WalkDirectory(const std::string &pathName);
+    void CheckManifest(const std::string &manifest);
+    bool ParseCheckLine(const std::string &line, HashJob &job) const;
+    static bool ParseCheckTag(const std::string &tag, HashJob &job);
+    void DisplayCheck(const HashJob &job);
+    int ReportCheckResults() const;
     void ReadConfig();
+    void OpenCache();
 
     bool arg_binary = false;
     bool arg_check = false;
     bool arg_tag = false;
+    bool arg_quiet = false;
+    bool arg_status = false;
     bool arg_help = false;
+    unsigned arg_jobs = 1;
+    std::string arg_backend = "auto";
+    std::string arg_io;
+    bool arg_cache = false;
+    bool arg_no_cache = false;
+    bool arg_refresh = false;
+    bool arg_recursive = false;
+    std::vector<std::string> arg_include;
+    std::vector<std::string> arg_exclude;
+    bool arg_chunked = false;
+    Poco::UInt64 arg_chunk_size = 4 * 1024 * 1024;
+    bool arg_chunks = false;
+    bool arg_stats = false;
+
+    const Sha256Backend *backend_ = nullptr;
+    const FileReader *reader_ = nullptr;
+
+    // Shared by the workers; it does its own locking.
+    mutable DigestCache cache_;
+
+    // Jobs queued but not yet printed, oldest first, and the ones still being
+    // collected into a batch.
+    std::deque<Poco::SharedPtr<HashJob>> pending_;
+    HashBatch batch_;
+    std::size_t window_ = 0;
+    Poco::NotificationQueue queue_;
+    bool parallel_ = false;
+
+    // --check tallies, for the closing warnings and the exit code.
+    unsigned improperlyFormatted_ = 0;
+    unsigned unreadable_ = 0;
+    unsigned mismatched_ = 0;
+    unsigned emptyManifests_ = 0;
+
+    // Files and directories --recursive couldn't read.
+    unsigned unreadableInTree_ = 0;
+
+    // Filled in by the workers; it does its own locking.
+    mutable HashStats stats_;
+
+    // Log messages queued past this many are dropped, and counted in the log.
+    static const std::size_t LOG_QUEUE_SIZE = 4096;
+    Poco::AutoPtr<AsyncLogChannel> logChannel_;
 };
 
 std::vector<std::string> Application::ExpandFileArgument(const std::string &file)
@@ -123,13 +416,252 @@ std::vector<std::string> Application::ExpandFileArgument(const std::string &file
     return files;
 }
 
-void Application::DisplayHash(const std::string &pathName)
+void Application::SubmitJob(const Poco::SharedPtr<HashJob> &job)
+{
+    if (job->chunkSize > 0)
+    {
+        // The file's chunks take up the whole pool, so everything before it
+        // has to be out of the way first.
+        FlushJobs(0);
+        ComputeChunked(*job);
+        job->dispatched = true;
+        job->done.set();
+    }
+    else if (job->message.empty())
+    {
+        batch_.push_back(job);
+        if (batch_.size() >= backend_->lanes())
+        {
+            DispatchBatch();
+        }
+    }
+    else
+    {
+        job->dispatched = true;
+        job->done.set();
+    }
+
+    pending_.push_back(job);
+
+    // Bound the number of in-flight jobs so memory stays flat however many
+    // files a glob expands to; workers keep busy while the oldest is printed.
+    FlushJobs(window_);
+}
+
+void Application::DispatchBatch()
+{
+    if (batch_.empty())
+    {
+        return;
+    }
+
+    for (const Poco::SharedPtr<HashJob> &job : batch_)
+    {
+        job->dispatched = true;
+    }
+
+    if (parallel_)
+    {
+        queue_.enqueueNotification(new HashNotification(batch_));
+    }
+    else
+    {
+        ComputeHashes(batch_);
+    }
+    batch_.clear();
+}
+
+void Application::FlushJobs(std::size_t keep)
+{
+    while (pending_.size() > keep)
+    {
+        Poco::SharedPtr<HashJob> job(pending_.front());
+        pending_.pop_front();
+
+        if (!job->dispatched)
+        {
+            DispatchBatch();
+        }
+        job->done.wait();
+        if (arg_check)
+        {
+            DisplayCheck(*job);
+        }
+        else
+        {
+            DisplayHash(*job);
+        }
+    }
+}
+
+void Application::StopWorkers(Poco::ThreadPool &pool, std::size_t count)
+{
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        queue_.enqueueNotification(new Poco::Notification);
+    }
+    pool.joinAll();
+}
+
+void Application::ComputeHashes(const HashBatch &batch) const noexcept
+{
+    // Small files collected for one multi-buffer pass at the end.
+    struct SmallFile
+    {
+        HashJob *job;
+        bool cacheable;
+        DigestCache::Key key;
+        HashStats::Timer timer;
+    };
+    std::vector<SmallFile> small;
+    std::vector<std::string> contents;
+
+    for (const Poco::SharedPtr<HashJob> &job : batch)
+    {
+        const HashStats::Timer timer;
+        try
+        {
+            Poco::Path path(job->pathName);
+            Poco::File file(path);
+            if (file.isDirectory())
+            {
+                job->isDirectory = true;
+            }
+            else if (job->isRange)
+            {
+                Sha256Engine engine(*backend_);
+                DigestFileRange(path.toString(), job->offset, job->length, engine);
+                job->digest = engine.digest();
+                stats_.recordFile(job->length, timer.elapsed());
+            }
+            else
+            {
+                DigestCache::Key key;
+                const bool cacheable = cache_.isOpen() && DigestCache::keyFor(path.toString(), key);
+                if (cacheable && !arg_refresh && cache_.lookup(key, job->digest))
+                {
+                    stats_.recordCacheHit(timer.elapsed());
+                }
+                else
+                {
+                    std::string data;
+                    if (batch.size() > 1 && ReadSmallFile(path.toString(), MULTI_BUFFER_FILE_LIMIT, data))
+                    {
+                        SmallFile file = {job.get(), cacheable, key, timer};
+                        small.push_back(file);
+                        contents.push_back(std::move(data));
+                        continue;
+                    }
+
+                    // Calculate hash
+                    Sha256Engine engine(*backend_);
+                    DigestFile(path.toString(), engine, *reader_);
+                    const Poco::UInt64 length = engine.length();
+                    job->digest = engine.digest();
+                    stats_.recordFile(length, timer.elapsed());
+
+                    if (cacheable)
+                    {
+                        CacheDigest(path.toString(), key, job->digest);
+                    }
+                }
+            }
+        }
+        catch (const Poco::Exception &e)
+        {
+            job->error = e.clone();
+            stats_.recordError();
+        }
+        catch (const std::exception &e)
+        {
+            job->error = new Poco::Exception(e.what());
+            stats_.recordError();
+        }
+
+        job->done.set();
+    }
+
+    if (!small.empty())
+    {
+        std::vector<Poco::DigestEngine::Digest> digests;
+        Sha256DigestMany(*backend_, contents, digests);
+        for (std::size_t i = 0; i < small.size(); ++i)
+        {
+            HashJob &job = *small[i].job;
+            job.digest = digests[i];
+            stats_.recordFile(contents[i].size(), small[i].timer.elapsed());
+            if (small[i].cacheable)
+            {
+                try
+                {
+                    CacheDigest(job.pathName, small[i].key, job.digest);
+                }
+                catch (...)
+                {
+                }
+            }
+            job.done.set();
+        }
+    }
+}
+
+void Application::ComputeChunked(HashJob &job) noexcept
+{
+    const HashStats::Timer timer;
+    try
+    {
+        if (IsDirectory(job.pathName))
+        {
+            job.isDirectory = true;
+            return;
+        }
+
+        ChunkedDigest digest(queue_, *backend_, job.chunkSize);
+        digest.compute(job.pathName);
+        job.digest = digest.root();
+        job.length = digest.size();
+        if (arg_chunks && !arg_check)
+        {
+            job.chunks = digest.chunks();
+        }
+        stats_.recordFile(job.length, timer.elapsed());
+    }
+    catch (...)
+    {
+        job.error = CaptureException();
+        stats_.recordError();
+    }
+}
+
+// Only remembers the digest if the file looks the same as before it was read,
+// so a file written to while being hashed doesn't poison the cache.
+void Application::CacheDigest(const std::string &pathName, const DigestCache::Key &key, const Poco::DigestEngine::Digest &digest) const
+{
+    DigestCache::Key after;
+    if (DigestCache::keyFor(pathName, after) && after == key)
+    {
+        cache_.store(key, digest);
+    }
+}
+
+void Application::DisplayHash(const HashJob &job)
 {
     poco_ndc(DisplayHash);
 
-    Poco::Path path(pathName);
-    Poco::File file(path);
-    if (file.isDirectory())
+    if (!job.message.empty())
+    {
+        std::cout << job.message << std::endl;
+        return;
+    }
+
+    // Errors surface on the main thread, in order, as if hashed serially.
+    if (job.error)
+    {
+        job.error->rethrow();
+    }
+
+    Poco::Path path(job.pathName);
+    if (job.isDirectory)
     {
         std::cout << commandName() << ": " << path.directory(path.depth() - 1) << ": Is a directory" << std::endl;
 
@@ -141,25 +673,280 @@ void Application::DisplayHash(const std::string &pathName)
         return;
     }
 
-    // Calculate hash
-    Poco::FileInputStream stream(path.toString());
-    Poco::SHA2Engine engine(Poco::SHA2Engine::SHA_256);
-    Poco::DigestInputStream digest(engine, stream);
-    Poco::NullOutputStream ostream;
-    Poco::StreamCopier::copyStream(digest, ostream);
+    if (job.chunkSize > 0)
+    {
+        // Chunked digests aren't plain SHA256, so they always carry their own
+        // tag, which --check reads back.
+        const std::string name(path.getFileName());
+        std::cout << "SHA256-MERKLE-" << job.chunkSize << " (" << name << ") = " << Poco::DigestEngine::digestToHex(job.digest) << std::endl;
+        for (std::size_t i = 0; i < job.chunks.size(); ++i)
+        {
+            const Poco::UInt64 offset = i * job.chunkSize;
+            std::cout << "SHA256-CHUNK " << offset << '+' << std::min(job.chunkSize, job.length - offset)
+                      << " (" << name << ") = " << Poco::DigestEngine::digestToHex(job.chunks[i]) << std::endl;
+        }
+        return;
+    }
+
+    DisplayDigest(job.digest, path.getFileName());
+}
 
+void Application::DisplayDigest(const Poco::DigestEngine::Digest &digest, const std::string &name) const
+{
     if (!arg_tag)
     {
         const std::string output(Poco::cat(
-            Poco::SHA2Engine::digestToHex(engine.digest()),
+            Poco::DigestEngine::digestToHex(digest),
             std::string(arg_binary ? " *" : "  "),
-            path.getFileName()));
+            name));
         std::cout << output << std::endl;
     }
     else
     {
-        std::cout << "SHA256 (" << path.getFileName() << ") = " << Poco::SHA2Engine::digestToHex(engine.digest()) << std::endl;
+        std::cout << "SHA256 (" << name << ") = " << Poco::DigestEngine::digestToHex(digest) << std::endl;
+    }
+}
+
+bool Application::IsDirectory(const std::string &pathName) const noexcept
+{
+    try
+    {
+        Poco::File file(pathName);
+        return file.exists() && file.isDirectory();
+    }
+    catch (const Poco::Exception &e)
+    {
+        return false;
+    }
+}
+
+// Hashes everything below a directory on the worker pool, then prints it in
+// name order under the directory's own name, the way DisplayHash prints a file.
+void Application::WalkDirectory(const std::string &pathName)
+{
+    poco_ndc(WalkDirectory);
+
+    // Earlier arguments print first.
+    FlushJobs(0);
+
+    TreeWalker walker(queue_, *backend_, *reader_, cache_.isOpen() ? &cache_ : nullptr, arg_refresh);
+    walker.setStats(&stats_);
+    for (const std::string &pattern : arg_include)
+    {
+        walker.include(pattern);
+    }
+    for (const std::string &pattern : arg_exclude)
+    {
+        walker.exclude(pattern);
+    }
+    walker.walk(pathName);
+
+    Poco::Path path(pathName);
+    path.makeAbsolute();
+    path.makeFile();
+    const std::string root(path.getFileName());
+
+    walker.visit([this, &root](const std::string &relative, const TreeWalker::Node &node) {
+        std::string name(root);
+        if (!relative.empty())
+        {
+            if (!name.empty())
+            {
+                name += '/';
+            }
+            name += relative;
+        }
+
+        if (node.error)
+        {
+            ++unreadableInTree_;
+            std::cerr << commandName() << ": " << node.error->displayText() << std::endl;
+            return;
+        }
+        DisplayDigest(node.digest, name);
+    });
+}
+
+void Application::CheckManifest(const std::string &manifest)
+{
+    // The manifest is read a line at a time and its entries go through the
+    // same bounded window as hashing, so memory doesn't grow with its size.
+    Poco::SharedPtr<Poco::FileInputStream> file;
+    std::istream *input = &std::cin;
+    if (manifest != "-")
+    {
+        try
+        {
+            file = new Poco::FileInputStream(manifest);
+        }
+        catch (const Poco::FileException &e)
+        {
+            ++unreadable_;
+            if (!arg_status)
+            {
+                std::cerr << commandName() << ": " << e.displayText() << std::endl;
+            }
+            return;
+        }
+        input = file.get();
+    }
+
+    unsigned entries = 0;
+    std::string line;
+    while (std::getline(*input, line))
+    {
+        Poco::SharedPtr<HashJob> job(new HashJob);
+        if (!ParseCheckLine(line, *job))
+        {
+            ++improperlyFormatted_;
+            continue;
+        }
+
+        ++entries;
+        SubmitJob(job);
+    }
+
+    if (entries == 0)
+    {
+        // Let earlier results out first so the message lands after them.
+        FlushJobs(0);
+
+        ++emptyManifests_;
+        if (!arg_status)
+        {
+            std::cerr << commandName() << ": " << manifest << ": no properly formatted SHA256 checksum lines found" << std::endl;
+        }
+    }
+}
+
+bool Application::ParseCheckLine(const std::string &text, HashJob &job) const
+{
+    std::string line(text);
+    if (!line.empty() && line[line.size() - 1] == '\r')
+    {
+        line.erase(line.size() - 1);
+    }
+
+    std::string hex;
+    const std::string tagOpen(" (");
+    const std::string tagSeparator(") = ");
+    const std::string::size_type open = line.find(tagOpen);
+    const std::string::size_type separator = line.rfind(tagSeparator);
+    if (open != std::string::npos && separator != std::string::npos && separator >= open + tagOpen.size() &&
+        ParseCheckTag(line.substr(0, open), job))
+    {
+        // SHA256 (name) = hex, or one of the --chunked tags
+        job.pathName = line.substr(open + tagOpen.size(), separator - open - tagOpen.size());
+        hex = line.substr(separator + tagSeparator.size());
+    }
+    else
+    {
+        // hex  name, or hex *name in binary mode
+        const std::string::size_type digits = 64;
+        if (line.size() < digits + 3 || line[digits] != ' ' || (line[digits + 1] != ' ' && line[digits + 1] != '*'))
+        {
+            return false;
+        }
+        hex = line.substr(0, digits);
+        job.pathName = line.substr(digits + 2);
+    }
+
+    if (hex.size() != 64 || hex.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos || job.pathName.empty())
+    {
+        return false;
+    }
+
+    job.expected = Poco::DigestEngine::digestFromHex(Poco::toLower(hex));
+    return true;
+}
+
+// Accepts SHA256, SHA256-MERKLE-<chunk size> and SHA256-CHUNK <offset>+<length>.
+bool Application::ParseCheckTag(const std::string &tag, HashJob &job)
+{
+    if (tag == "SHA256")
+    {
+        return true;
+    }
+
+    const std::string merkle("SHA256-MERKLE-");
+    if (tag.compare(0, merkle.size(), merkle) == 0)
+    {
+        return Poco::NumberParser::tryParseUnsigned64(tag.substr(merkle.size()), job.chunkSize) && IsChunkSize(job.chunkSize);
+    }
+
+    const std::string chunk("SHA256-CHUNK ");
+    const std::string::size_type plus = tag.find('+');
+    if (tag.compare(0, chunk.size(), chunk) == 0 && plus != std::string::npos && plus > chunk.size())
+    {
+        job.isRange = Poco::NumberParser::tryParseUnsigned64(tag.substr(chunk.size(), plus - chunk.size()), job.offset) &&
+                      Poco::NumberParser::tryParseUnsigned64(tag.substr(plus + 1), job.length);
+        return job.isRange;
+    }
+
+    return false;
+}
+
+void Application::DisplayCheck(const HashJob &job)
+{
+    std::string name(job.pathName);
+    if (job.isRange)
+    {
+        name += " [" + Poco::NumberFormatter::format(job.offset) + "+" + Poco::NumberFormatter::format(job.length) + "]";
     }
+
+    if (job.error || job.isDirectory)
+    {
+        ++unreadable_;
+        if (!arg_status)
+        {
+            if (job.isDirectory)
+            {
+                std::cerr << commandName() << ": " << name << ": Is a directory" << std::endl;
+            }
+            else
+            {
+                std::cerr << commandName() << ": " << job.error->displayText() << std::endl;
+            }
+            std::cout << name << ": FAILED open or read" << std::endl;
+        }
+        return;
+    }
+
+    const bool matched = job.digest == job.expected;
+    if (!matched)
+    {
+        ++mismatched_;
+    }
+
+    if (arg_status || (matched && arg_quiet))
+    {
+        return;
+    }
+    std::cout << name << ": " << (matched ? "OK" : "FAILED") << std::endl;
+}
+
+int Application::ReportCheckResults() const
+{
+    if (!arg_status)
+    {
+        if (improperlyFormatted_ > 0)
+        {
+            std::cerr << commandName() << ": WARNING: " << improperlyFormatted_
+                      << (improperlyFormatted_ == 1 ? " line is" : " lines are") << " improperly formatted" << std::endl;
+        }
+        if (unreadable_ > 0)
+        {
+            std::cerr << commandName() << ": WARNING: " << unreadable_
+                      << (unreadable_ == 1 ? " listed file" : " listed files") << " could not be read" << std::endl;
+        }
+        if (mismatched_ > 0)
+        {
+            std::cerr << commandName() << ": WARNING: " << mismatched_
+                      << (mismatched_ == 1 ? " computed checksum" : " computed checksums") << " did NOT match" << std::endl;
+        }
+    }
+
+    return unreadable_ == 0 && mismatched_ == 0 && emptyManifests_ == 0 ? EXIT_OK : EXIT_FAILURE;
 }
 
 void Application::ReadConfig()
@@ -208,17 +995,55 @@ void Application::ReadConfig()
     catch (const Poco::NotFoundException &e)
     {
     }
+
+    // e.g. "cache": 1 turns on the digest cache for every run.
+    arg_cache = arg_cache || configs->getBool("config.cache", false);
+
+    // e.g. "io": "uring" for storage where keeping reads in flight pays off.
+    if (arg_io.empty())
+    {
+        arg_io = configs->getString("config.io", "auto");
+    }
+}
+
+void Application::OpenCache()
+{
+    if (!arg_cache || arg_no_cache)
+    {
+        return;
+    }
+
+    // Kept next to the configuration files ReadConfig looks for.
+    Poco::Path cachePath(Poco::Path::configHome());
+    cachePath.append(Poco::cat(commandName(), std::string(".cache")));
+
+    try
+    {
+        Poco::File(cachePath.parent()).createDirectories();
+    }
+    catch (const Poco::FileException &e)
+    {
+    }
+
+    if (!cache_.open(cachePath.toString()))
+    {
+        Poco::Logger::get("TestLogger").warning(Poco::cat(std::string("digest cache unavailable: "), cachePath.toString()));
+    }
 }
 
 int Application::main(const std::vector<std::string> &arguments)
 {
     poco_ndc(main);
 
+    // Written from a background thread, so a glob of a million files doesn't
+    // wait on a million log writes.
     Poco::AutoPtr<Poco::SimpleFileChannel> channel(new Poco::SimpleFileChannel);
     Poco::Path logDir(Poco::Path::tempHome(), "sha256sum.log");
     channel->setProperty("path", logDir.toString());
-    channel->setProperty("rotation", "2 K");
-    Poco::Logger::root().setChannel(channel);
+    channel->setProperty("rotation", "4 M"); // two files of this size are kept
+    logChannel_ = new AsyncLogChannel(channel, LOG_QUEUE_SIZE);
+    logChannel_->open();
+    Poco::Logger::root().setChannel(logChannel_);
     Poco::Logger &log = Poco::Logger::get("TestLogger");
 
     log.information("app started");
@@ -231,41 +1056,110 @@ int Application::main(const std::vector<std::string> &arguments)
         return EXIT_USAGE;
     }
 
-    if (arg_check)
-    {
-        log.fatal("check requested");
-
-        std::cerr << "check not yet implemented." << std::endl;
-        return EXIT_FAILURE;
-    }
+    const HashStats::Timer wallClock;
 
     ReadConfig();
+    OpenCache();
 
-    for (const std::string &argument : arguments)
+    try
+    {
+        backend_ = &Sha256Backend::select(arg_backend);
+        reader_ = &FileReader::select(arg_io);
+    }
+    catch (const Poco::InvalidArgumentException &e)
     {
-        std::vector<std::string> files(ExpandFileArgument(argument));
-        if (files.empty())
+        std::cerr << commandName() << ": " << e.displayText() << std::endl;
+        return EXIT_USAGE;
+    }
+
+    // With --jobs, files are hashed on a pool but still printed in argument
+    // order, so the output matches a serial run byte for byte.
+    parallel_ = arg_jobs > 1;
+    window_ = parallel_ ? arg_jobs * 4 * backend_->lanes() : backend_->lanes() - 1;
+    Poco::ThreadPool pool(1, parallel_ ? static_cast<int>(arg_jobs) : 1);
+    std::vector<Poco::SharedPtr<HashWorker>> workers;
+    if (parallel_)
+    {
+        for (unsigned i = 0; i < arg_jobs; ++i)
         {
-            std::cout << commandName() << ": '" << argument << "': No such file or directory" << std::endl;
-            continue;
+            Poco::SharedPtr<HashWorker> worker(new HashWorker(*this, queue_));
+            workers.push_back(worker);
+            pool.start(*worker);
         }
+    }
 
-        for (const std::string &file : files)
+    try
+    {
+        for (const std::string &argument : arguments)
         {
-            log.information(Poco::cat(std::string("file: "), file));
+            if (arg_check)
+            {
+                log.information(Poco::cat(std::string("check: "), argument));
+
+                CheckManifest(argument);
+                continue;
+            }
 
-            if (!arg_check)
+            // A directory named as such, trailing slash and all, which
+            // ExpandFileArgument would turn away.
+            if (arg_recursive && IsDirectory(argument))
             {
-                DisplayHash(file);
+                log.information(Poco::cat(std::string("tree: "), argument));
+
+                WalkDirectory(argument);
+                continue;
             }
-            else
+
+            std::vector<std::string> files(ExpandFileArgument(argument));
+            if (files.empty())
             {
+                Poco::SharedPtr<HashJob> job(new HashJob);
+                job->message = Poco::cat(commandName(), std::string(": '"), argument, std::string("': No such file or directory"));
+                SubmitJob(job);
+                continue;
+            }
+
+            for (const std::string &file : files)
+            {
+                log.information(Poco::cat(std::string("file: "), file));
+
+                if (arg_recursive && IsDirectory(file))
+                {
+                    WalkDirectory(file);
+                    continue;
+                }
+
+                Poco::SharedPtr<HashJob> job(new HashJob);
+                job->pathName = file;
+                job->chunkSize = arg_chunked ? arg_chunk_size : 0;
+                SubmitJob(job);
             }
         }
+
+        FlushJobs(0);
+    }
+    catch (...)
+    {
+        // Drop the backlog and let the workers finish the job in hand before
+        // the exception unwinds the queue they're reading from.
+        queue_.clear();
+        StopWorkers(pool, workers.size());
+        throw;
+    }
+
+    StopWorkers(pool, workers.size());
+
+    if (arg_stats)
+    {
+        stats_.report(std::cerr, wallClock.elapsed() / 1e9);
     }
 
     log.information("app ended");
-    return EXIT_OK;
+    if (arg_check)
+    {
+        return ReportCheckResults();
+    }
+    return unreadableInTree_ == 0 ? EXIT_OK : EXIT_FAILURE;
 }
 
 POCO_APP_MAIN(Application)